@@ -0,0 +1,62 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <twitchsw/string.h>
+
+#include <string>
+
+namespace twitchsw {
+
+// A String which shares its StringImpl with every other AtomString of the same
+// characters, so that comparing two of them compares pointers. Meant for the
+// names which recur constantly: scenes, games and settings.
+//
+// Atoms live in a process-wide table which is safe to use from any thread, and
+// leave it when their last reference goes away.
+class AtomString {
+public:
+    AtomString() { }
+    AtomString(const char* characters);
+    AtomString(const char* characters, unsigned length);
+    AtomString(const std::string& string);
+    explicit AtomString(const String& string);
+
+    bool isNull() const { return m_string.isNull(); }
+    bool isEmpty() const { return m_string.isEmpty(); }
+    unsigned length() const { return m_string.length(); }
+    const char* characters() const { return m_string.characters(); }
+
+    StringImpl* impl() const { return m_string.impl(); }
+    const String& string() const { return m_string; }
+    std::string toStdString() const { return m_string.toStdString(); }
+    unsigned hash() const { return m_string.hash(); }
+
+    friend bool operator==(const AtomString& a, const AtomString& b) { return a.impl() == b.impl(); }
+    friend bool operator!=(const AtomString& a, const AtomString& b) { return a.impl() != b.impl(); }
+
+    // Number of distinct atoms alive, for tests.
+    static size_t tableSize();
+
+private:
+    friend class StringImpl;
+    static RefPtr<StringImpl> add(const char* characters, unsigned length);
+    // Called by StringImpl::destroy() for atoms.
+    static void remove(StringImpl& impl);
+
+    String m_string;
+};
+
+// Atoms are unique, so equal atoms are the same impl, whose hash is cached.
+struct AtomStringHash {
+    size_t operator()(const AtomString& string) const { return string.hash(); }
+};
+
+}  // namespace twitchsw
+
+namespace std {
+template <> struct hash<twitchsw::AtomString> : twitchsw::AtomStringHash { };
+}  // namespace std
@@ -0,0 +1,75 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <twitchsw/gameindex.h>
+#include <twitchsw/http.h>
+#include <twitchsw/refs.h>
+
+namespace twitchsw {
+
+class ChannelProfile;
+class GameIdCache;
+
+// The Twitch API which channel updates are sent to. Requests are made from the
+// threads which send updates in parallel, so implementations must not keep
+// per-request state.
+class ChannelApi : public ThreadSafeRefCounted<ChannelApi> {
+public:
+    enum class Kind {
+        // v3 Kraken: PUT /channels/<name>, with a free-text game.
+        Kraken,
+
+        // ID-based: PATCH /channels?broadcaster_id=<id>, with a game ID resolved
+        // through `gameIds`.
+        Helix
+    };
+
+    static const char* defaultBaseUrl(Kind kind);
+    static bool parseKind(const std::string& name, Kind& kind);
+
+    // An empty `baseUrl` uses the default for `kind`. `gameIds` must outlive the
+    // returned object.
+    static Ref<ChannelApi> create(Kind kind, const std::string& baseUrl, GameIdCache& gameIds);
+
+    virtual ~ChannelApi() {}
+
+    static bool isSuccess(const HttpResponse& response) {
+        return response.status() >= 200 && response.status() < 300;
+    }
+
+    // Looks up the channel owned by the profile's account. `name` is left empty if
+    // the response could not be understood.
+    virtual HttpResponse fetchChannel(const ChannelProfile& profile, std::string& name, std::string& id) = 0;
+
+    virtual HttpResponse updateChannel(const ChannelProfile& profile, const std::string& channelName, const std::string& channelId,
+                                       const std::string& game, const std::string& title) = 0;
+
+    // Suggests games for a partially typed `query`, best match first. `accessToken`
+    // may be empty, if no profile has signed in yet. Setting `cancelled` aborts
+    // the request.
+    virtual HttpResponse searchGames(const std::string& accessToken, const std::string& query,
+                                     const HttpCancelFlag& cancelled, std::vector<GameSuggestion>& games) = 0;
+
+    // Returns true if `games`, as returned by a successful searchGames(), are
+    // every game the query matches, rather than the first page of them.
+    virtual bool isCompleteSearch(const std::vector<GameSuggestion>& games) const = 0;
+
+    const std::string& baseUrl() const { return m_baseUrl; }
+
+protected:
+    explicit ChannelApi(const std::string& baseUrl)
+        : m_baseUrl(baseUrl)
+    {
+    }
+
+    const std::string m_baseUrl;
+};
+
+}  // namespace twitchsw
@@ -0,0 +1,87 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <twitchsw/refs.h>
+
+namespace twitchsw {
+
+// A Twitch account (and the channel it owns) which scene updates are sent to.
+// Each profile signs in separately, and remembers what it last sent so that
+// redundant updates are skipped.
+//
+// Profiles are owned by the WorkerThread, but are read and updated from the
+// threads which send updates in parallel, so all state is guarded by a mutex.
+// Everything is stored as std::string, which is what ChannelApi takes, so that
+// the getters can hand each caller its own copy, made under the lock.
+class ChannelProfile : public ThreadSafeRefCounted<ChannelProfile> {
+public:
+    static const char* const kDefaultName;
+
+    static Ref<ChannelProfile> create(const std::string& name) {
+        return adoptRef(*new ChannelProfile(name));
+    }
+
+    // Splits a comma-separated list of profile names, trimming whitespace and
+    // dropping duplicates. An empty list names only the default profile.
+    static std::vector<std::string> parseNames(const std::string& names);
+
+    const std::string& name() const { return m_name; }
+
+    std::string accessToken() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_accessToken;
+    }
+    bool hasAccessToken() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return !m_accessToken.empty();
+    }
+    // Forgets the cached channel if the token changes.
+    void setAccessToken(const std::string& accessToken);
+
+    // The channel owned by the signed-in account, cached so that updates don't
+    // have to look it up first. Returns false if it is not known yet.
+    bool channel(std::string& name, std::string& id) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_channelName.empty())
+            return false;
+        name = m_channelName;
+        id = m_channelId;
+        return true;
+    }
+    void setChannel(const std::string& name, const std::string& id);
+    void invalidateChannel();
+
+    // True if `game` and `title` are what this profile's channel was last
+    // successfully updated to.
+    bool isUpToDate(const std::string& game, const std::string& title) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_hasLastUpdate && m_lastGame == game && m_lastTitle == title;
+    }
+    void didUpdate(const std::string& game, const std::string& title);
+
+private:
+    explicit ChannelProfile(const std::string& name)
+        : m_name(name)
+    {
+    }
+
+    const std::string m_name;
+
+    mutable std::mutex m_mutex;
+    std::string m_accessToken;
+    std::string m_channelName;
+    std::string m_channelId;
+    bool m_hasLastUpdate = false;
+    std::string m_lastGame;
+    std::string m_lastTitle;
+};
+
+}  // namespace twitchsw
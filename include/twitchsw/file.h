@@ -0,0 +1,52 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace twitchsw {
+
+// Returns false if the file does not exist or could not be read.
+bool readFile(const std::string& path, std::string& contents);
+
+// Writes beside `path` and renames over it, so that a crash mid-write never
+// leaves a truncated file behind. The file is only readable by the current user.
+bool writeFileAtomically(const std::string& path, const std::string& contents);
+
+// writeFileAtomically() in two steps, for callers which must not have the file
+// open while it is replaced, but shouldn't wait for the write to reach the disk
+// before closing it. Each returns false on failure, and leaves nothing behind.
+bool writeTemporaryFile(const std::string& path, const std::string& contents);
+bool replaceWithTemporaryFile(const std::string& path);
+
+// A read-only view of a whole file, mapped into memory rather than read. The
+// file must not be replaced while it is mapped: on Windows, replacing it fails.
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file does not exist, is empty, or could not be mapped.
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+#if defined(TSW_WIN32) && TSW_WIN32
+    void* m_mapping = nullptr;
+#endif
+};
+
+}  // namespace twitchsw
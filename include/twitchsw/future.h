@@ -0,0 +1,491 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <twitchsw/refs.h>
+
+namespace twitchsw {
+
+// Runs continuations. Implementations decide which thread a task runs on.
+class Executor {
+public:
+    virtual ~Executor() {}
+    virtual void post(std::function<void()>&& task) = 0;
+};
+
+// Runs tasks immediately, on the thread which settled the future (or which
+// attached the continuation, if the future was already settled).
+class InlineExecutor : public Executor {
+public:
+    void post(std::function<void()>&& task) override { task(); }
+
+    static InlineExecutor& shared() {
+        static InlineExecutor executor;
+        return executor;
+    }
+};
+
+class FutureError : public std::exception {
+public:
+    enum class Code {
+        // Every Promise for the future was destroyed without settling it.
+        BrokenPromise,
+        Cancelled
+    };
+
+    explicit FutureError(Code code) : m_code(code) {}
+
+    Code code() const { return m_code; }
+    const char* what() const noexcept override {
+        return m_code == Code::Cancelled ? "Future was cancelled" : "Promise was destroyed without a value";
+    }
+
+private:
+    Code m_code;
+};
+
+template <typename T> class Future;
+template <typename T> class Promise;
+
+namespace detail {
+
+template <typename T>
+class FutureValue {
+public:
+    void set(T&& value) { m_value.reset(new T(std::move(value))); }
+    void set(const T& value) { m_value.reset(new T(value)); }
+    T get() const { return *m_value; }
+
+private:
+    std::unique_ptr<T> m_value;
+};
+
+template <>
+class FutureValue<void> {
+public:
+    void get() const {}
+};
+
+template <typename T>
+class FutureState : public ThreadSafeRefCounted<FutureState<T>> {
+public:
+    enum class Status {
+        Pending,
+        Fulfilled,
+        Rejected,
+        Cancelled
+    };
+
+    static Ref<FutureState> create() { return adoptRef(*new FutureState()); }
+
+    Status status() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_status;
+    }
+
+    template <typename Setter>
+    bool settle(Status status, Setter&& setter) {
+        std::vector<std::function<void()>> callbacks;
+        std::function<void()> onCancel;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_status != Status::Pending)
+                return false;
+            setter(*this);
+            m_status = status;
+            callbacks.swap(m_callbacks);
+            if (status == Status::Cancelled)
+                onCancel.swap(m_onCancel);
+            else
+                m_onCancel = nullptr;
+        }
+        m_settled.notify_all();
+
+        // Run outside of the lock, as either may settle other futures, or
+        // attach continuations to this one.
+        if (onCancel)
+            onCancel();
+        for (auto& callback : callbacks)
+            callback();
+        return true;
+    }
+
+    bool cancel() {
+        return settle(Status::Cancelled, [](FutureState&) { });
+    }
+
+    bool reject(std::exception_ptr error) {
+        return settle(Status::Rejected, [&error](FutureState& state) { state.m_error = error; });
+    }
+
+    // Runs `callback` once the state is settled, immediately if it already is.
+    void addCallback(std::function<void()>&& callback) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_status == Status::Pending) {
+                m_callbacks.push_back(std::move(callback));
+                return;
+            }
+        }
+        callback();
+    }
+
+    void setOnCancel(std::function<void()>&& onCancel) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_status == Status::Pending)
+            m_onCancel = std::move(onCancel);
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_settled.wait(lock, [this] { return m_status != Status::Pending; });
+    }
+
+    template <typename Rep, typename Period>
+    bool waitFor(const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_settled.wait_for(lock, timeout, [this] { return m_status != Status::Pending; });
+    }
+
+    T get() {
+        wait();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_status == Status::Rejected)
+            std::rethrow_exception(m_error);
+        if (m_status == Status::Cancelled)
+            throw FutureError(FutureError::Code::Cancelled);
+        return m_value.get();
+    }
+
+    // Promise handles, so that the state is rejected once the last one goes away.
+    void addPromise() { ++m_promises; }
+    void removePromise() {
+        if (!--m_promises)
+            reject(std::make_exception_ptr(FutureError(FutureError::Code::BrokenPromise)));
+    }
+
+    FutureValue<T> m_value;
+
+private:
+    FutureState() {}
+
+    std::mutex m_mutex;
+    std::condition_variable m_settled;
+    Status m_status = Status::Pending;
+    std::exception_ptr m_error;
+    std::vector<std::function<void()>> m_callbacks;
+    std::function<void()> m_onCancel;
+    std::atomic<int> m_promises { 0 };
+};
+
+template <typename T>
+struct UnwrapFuture {
+    typedef T Type;
+};
+
+template <typename T>
+struct UnwrapFuture<Future<T>> {
+    typedef T Type;
+};
+
+// Calls a continuation, and settles the Promise for its result.
+template <typename Result>
+struct InvokeContinuation {
+    template <typename Function, typename Argument>
+    static void run(Promise<Result>& promise, Function& function, Argument&& argument) {
+        promise.setValue(function(std::forward<Argument>(argument)));
+    }
+};
+
+template <>
+struct InvokeContinuation<void> {
+    template <typename Function, typename Argument>
+    static void run(Promise<void>& promise, Function& function, Argument&& argument);
+};
+
+template <typename T>
+struct InvokeContinuation<Future<T>> {
+    template <typename Function, typename Argument>
+    static void run(Promise<T>& promise, Function& function, Argument&& argument);
+};
+
+}  // namespace detail
+
+// The consuming side of an asynchronous result. Futures are cheap handles to
+// shared state, and may be copied between threads.
+template <typename T>
+class Future {
+public:
+    typedef detail::FutureState<T> State;
+
+    Future() {}
+
+    bool isValid() const { return !!m_state; }
+    bool isReady() const { return m_state->status() != State::Status::Pending; }
+    bool isCancelled() const { return m_state->status() == State::Status::Cancelled; }
+
+    void wait() const { m_state->wait(); }
+
+    // Returns false if the future is still pending after `timeout`.
+    template <typename Rep, typename Period>
+    bool waitFor(const std::chrono::duration<Rep, Period>& timeout) const { return m_state->waitFor(timeout); }
+
+    // Blocks until settled. Rethrows the exception the future was rejected with,
+    // or throws FutureError if it was cancelled or the Promise was broken.
+    T get() const { return m_state->get(); }
+
+    // Settles a pending future as cancelled, and runs the producer's cancellation
+    // handler. Continuations are not called, and their futures are cancelled too.
+    // Returns false if the future was already settled.
+    bool cancel() { return m_state->cancel(); }
+
+    // Runs `function(Future<T>)` on `executor` once this future is settled. The
+    // returned future settles with its result. If `function` returns a Future,
+    // the returned future settles with that future's result instead.
+    //
+    // Cancelling the returned future cancels this one, if it is still pending.
+    // The executor must outlive the continuation.
+    template <typename Function>
+    auto then(Executor& executor, Function&& function)
+        -> Future<typename detail::UnwrapFuture<typename std::result_of<Function(Future<T>)>::type>::Type>;
+
+private:
+    friend class Promise<T>;
+    explicit Future(RefPtr<State>&& state) : m_state(std::move(state)) {}
+
+    RefPtr<State> m_state;
+};
+
+// The producing side of an asynchronous result. Promises may be copied; the
+// future is rejected with FutureError::Code::BrokenPromise if the last copy is
+// destroyed before it is settled.
+template <typename T>
+class Promise {
+public:
+    typedef detail::FutureState<T> State;
+
+    Promise()
+        : m_state(State::create())
+    {
+        m_state->addPromise();
+    }
+
+    Promise(const Promise& other)
+        : m_state(other.m_state)
+    {
+        m_state->addPromise();
+    }
+
+    Promise(Promise&& other)
+        : m_state(std::move(other.m_state))
+    {
+    }
+
+    Promise& operator=(Promise other) {
+        std::swap(m_state, other.m_state);
+        return *this;
+    }
+
+    ~Promise() {
+        if (m_state)
+            m_state->removePromise();
+    }
+
+    Future<T> future() const { return Future<T>(m_state.copyRef()); }
+
+    bool isCancelled() const { return m_state->status() == State::Status::Cancelled; }
+
+    // Each of these returns false if the future was already settled.
+    template <typename U = T>
+    bool setValue(typename std::enable_if<!std::is_void<U>::value, U>::type value) {
+        return m_state->settle(State::Status::Fulfilled, [&value](State& state) { state.m_value.set(std::move(value)); });
+    }
+    template <typename U = T>
+    typename std::enable_if<std::is_void<U>::value, bool>::type setValue() {
+        return m_state->settle(State::Status::Fulfilled, [](State&) { });
+    }
+    bool setException(std::exception_ptr error) { return m_state->reject(error); }
+    bool cancel() { return m_state->cancel(); }
+
+    // Settles with the same outcome as `settled`, which must be ready.
+    void setFrom(const Future<T>& settled);
+
+    // Called (on the cancelling thread) if the future is cancelled while pending,
+    // so that the producer can abandon its work.
+    void setOnCancel(std::function<void()>&& onCancel) { m_state->setOnCancel(std::move(onCancel)); }
+
+private:
+    RefPtr<State> m_state;
+};
+
+template <typename T>
+Future<typename std::decay<T>::type> makeReadyFuture(T&& value) {
+    Promise<typename std::decay<T>::type> promise;
+    promise.setValue(std::forward<T>(value));
+    return promise.future();
+}
+
+inline Future<void> makeReadyFuture() {
+    Promise<void> promise;
+    promise.setValue();
+    return promise.future();
+}
+
+template <typename T>
+Future<T> makeExceptionalFuture(std::exception_ptr error) {
+    Promise<T> promise;
+    promise.setException(error);
+    return promise.future();
+}
+
+// Fulfilled once every future in `futures` is settled, however it settled.
+// Cancelling the result cancels every input which is still pending.
+template <typename T>
+Future<void> whenAll(const std::vector<Future<T>>& futures) {
+    if (futures.empty())
+        return makeReadyFuture();
+
+    struct Counter : public ThreadSafeRefCounted<Counter> {
+        explicit Counter(size_t count) : remaining(count) {}
+        std::atomic<size_t> remaining;
+        Promise<void> promise;
+    };
+    RefPtr<Counter> counter = adoptRef(new Counter(futures.size()));
+    Future<void> result = counter->promise.future();
+    std::vector<Future<T>> inputs = futures;
+    counter->promise.setOnCancel([inputs]() mutable {
+        for (auto& input : inputs)
+            input.cancel();
+    });
+    for (auto input : futures) {
+        input.then(InlineExecutor::shared(), [counter](Future<T>) {
+            if (!--counter->remaining)
+                counter->promise.setValue();
+        });
+    }
+    return result;
+}
+
+// Fulfilled with the index of the first future in `futures` to settle.
+// Cancelling the result cancels every input which is still pending.
+template <typename T>
+Future<size_t> whenAny(const std::vector<Future<T>>& futures) {
+    // With nothing to wait for, the result would never settle.
+    assert(!futures.empty());
+    struct First : public ThreadSafeRefCounted<First> {
+        Promise<size_t> promise;
+    };
+    RefPtr<First> first = adoptRef(new First());
+    Future<size_t> result = first->promise.future();
+    std::vector<Future<T>> inputs = futures;
+    first->promise.setOnCancel([inputs]() mutable {
+        for (auto& input : inputs)
+            input.cancel();
+    });
+    for (size_t i = 0; i < futures.size(); ++i) {
+        Future<T> input = futures[i];
+        input.then(InlineExecutor::shared(), [first, i](Future<T>) {
+            first->promise.setValue(i);
+        });
+    }
+    return result;
+}
+
+//
+// Implementation
+//
+
+namespace detail {
+
+template <typename T>
+struct SetFromFuture {
+    static void run(Promise<T>& promise, const Future<T>& settled) { promise.setValue(settled.get()); }
+};
+
+template <>
+struct SetFromFuture<void> {
+    static void run(Promise<void>& promise, const Future<void>& settled) {
+        settled.get();
+        promise.setValue();
+    }
+};
+
+template <typename Function, typename Argument>
+void InvokeContinuation<void>::run(Promise<void>& promise, Function& function, Argument&& argument) {
+    function(std::forward<Argument>(argument));
+    promise.setValue();
+}
+
+template <typename T>
+template <typename Function, typename Argument>
+void InvokeContinuation<Future<T>>::run(Promise<T>& promise, Function& function, Argument&& argument) {
+    Future<T> inner = function(std::forward<Argument>(argument));
+    promise.setOnCancel([inner]() mutable { inner.cancel(); });
+    inner.then(InlineExecutor::shared(), [promise](Future<T> settled) mutable {
+        promise.setFrom(settled);
+    });
+}
+
+}  // namespace detail
+
+template <typename T>
+void Promise<T>::setFrom(const Future<T>& settled) {
+    if (settled.isCancelled()) {
+        cancel();
+        return;
+    }
+    try {
+        detail::SetFromFuture<T>::run(*this, settled);
+    } catch (...) {
+        setException(std::current_exception());
+    }
+}
+
+template <typename T>
+template <typename Function>
+auto Future<T>::then(Executor& executor, Function&& function)
+    -> Future<typename detail::UnwrapFuture<typename std::result_of<Function(Future<T>)>::type>::Type> {
+    typedef typename std::result_of<Function(Future<T>)>::type Result;
+    typedef typename detail::UnwrapFuture<Result>::Type Value;
+
+    Promise<Value> promise;
+    Future<Value> result = promise.future();
+    Future<T> self = *this;
+    promise.setOnCancel([self]() mutable { self.cancel(); });
+
+    typename std::decay<Function>::type continuation(std::forward<Function>(function));
+    Executor* target = &executor;
+    m_state->addCallback([target, self, promise, continuation]() mutable {
+        if (self.isCancelled()) {
+            promise.cancel();
+            return;
+        }
+        target->post([self, promise, continuation]() mutable {
+            if (promise.isCancelled())
+                return;
+            try {
+                detail::InvokeContinuation<Result>::run(promise, continuation, self);
+            } catch (...) {
+                promise.setException(std::current_exception());
+            }
+        });
+    });
+    return result;
+}
+
+}  // namespace twitchsw
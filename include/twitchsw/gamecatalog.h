@@ -0,0 +1,156 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <twitchsw/file.h>
+
+namespace twitchsw {
+
+// The games which typeahead searches found in earlier sessions, in a binary file
+// which is mapped rather than read. Opening the catalog only checks its header,
+// so it is usable as soon as OBS starts. Not thread-safe: GameIndex guards it.
+//
+// The file holds, in order:
+// - a Header;
+// - each game's popularity, as uint64_t;
+// - a GameRecord per game;
+// - each game's best search position, as uint32_t;
+// - a KeyRecord per word of each game's folded name, sorted by the folded text
+//   from that word to the end of the name;
+// - a QueryRecord per folded query which was searched for, sorted, and whether
+//   its search returned every matching game;
+// - the string pool, followed by kPoolPadding zero bytes.
+//
+// Integers are in the byte order of the machine which wrote the file. A file from
+// another machine, or another version, is ignored and rebuilt.
+class GameCatalog {
+public:
+    static const uint32_t kVersion = 2;
+
+    // Lets prefix comparisons load whole vectors without checking for the end of
+    // the pool.
+    static const size_t kPoolPadding = 16;
+
+    struct Game {
+        std::string name;
+
+        // GameIndex::normalize() of the name.
+        std::string folded;
+        uint64_t popularity;
+        size_t position;
+    };
+
+    struct Query {
+        // GameIndex::normalize() of the query.
+        std::string folded;
+
+        // The search returned less than a full page, so no other game matches.
+        bool complete;
+    };
+
+    GameCatalog() {}
+
+    // Returns false if the file is missing or unusable.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+
+    size_t gameCount() const;
+    std::string name(size_t game) const;
+    std::string folded(size_t game) const;
+    uint64_t popularity(size_t game) const;
+    size_t position(size_t game) const;
+
+    // Calls `function(game)` once per key which starts with `foldedPrefix`, so a
+    // game may be visited more than once.
+    template <typename Function>
+    void forEachMatch(const std::string& foldedPrefix, Function function) const;
+
+    // Sets `complete` if the query was found.
+    bool hasQuery(const std::string& foldedQuery, bool* complete = nullptr) const;
+
+    // Reads everything back, so that the catalog can be rebuilt with new games.
+    void read(std::vector<Game>& games, std::vector<Query>& queries) const;
+
+    // Returns the contents of a catalog file. `games` must not repeat a name,
+    // and of repeated queries, the first is kept.
+    static std::string build(const std::vector<Game>& games, const std::vector<Query>& queries);
+
+    // Compares the folded text of a key with a folded prefix: zero if the key
+    // starts with the prefix, and otherwise the order of the two strings. Both
+    // must be readable for `prefixLength` rounded up to a multiple of 16 bytes.
+    static int comparePrefix(const char* key, size_t keyLength, const char* prefix, size_t prefixLength);
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t gameCount;
+        uint32_t keyCount;
+        uint32_t queryCount;
+        uint32_t poolSize;
+        uint32_t reserved;
+    };
+
+    struct GameRecord {
+        uint32_t name;
+        uint32_t nameLength;
+        uint32_t folded;
+        uint32_t foldedLength;
+    };
+
+    struct KeyRecord {
+        uint32_t text;
+        uint32_t length;
+        uint32_t game;
+    };
+
+    struct QueryRecord {
+        uint32_t text;
+        uint32_t length;
+        uint32_t complete;
+    };
+
+    // Returns null if the range is outside of the pool.
+    const char* text(uint32_t offset, uint32_t length) const;
+
+    // The first key which does not order before `prefix`.
+    size_t lowerBound(const char* prefix, size_t prefixLength) const;
+
+    MappedFile m_file;
+    const Header* m_header = nullptr;
+    const uint64_t* m_popularity = nullptr;
+    const GameRecord* m_games = nullptr;
+    const uint32_t* m_positions = nullptr;
+    const KeyRecord* m_keys = nullptr;
+    const QueryRecord* m_queries = nullptr;
+    const char* m_pool = nullptr;
+};
+
+template <typename Function>
+void GameCatalog::forEachMatch(const std::string& foldedPrefix, Function function) const {
+    if (!isOpen() || foldedPrefix.empty())
+        return;
+    // Padded, so that comparisons can load whole vectors of the prefix too.
+    std::string prefix = foldedPrefix;
+    prefix.resize((prefix.length() + 15) / 16 * 16, '\0');
+    for (size_t i = lowerBound(prefix.data(), foldedPrefix.length()); i < m_header->keyCount; ++i) {
+        const KeyRecord& key = m_keys[i];
+        const char* keyText = text(key.text, key.length);
+        if (!keyText || comparePrefix(keyText, key.length, prefix.data(), foldedPrefix.length()))
+            break;
+        if (key.game < m_header->gameCount)
+            function(static_cast<size_t>(key.game));
+    }
+}
+
+}  // namespace twitchsw
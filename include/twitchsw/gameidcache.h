@@ -0,0 +1,49 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <mutex>
+#include <string>
+
+#include <twitchsw/lrucache.h>
+
+namespace twitchsw {
+
+// Maps the game names typed into TwitchSwitcher items to the IDs which the
+// ID-based API expects, so that each name is resolved once rather than on every
+// update. Kept on disk between sessions.
+//
+// Looked up from the threads which send updates in parallel, so all state is
+// guarded by a mutex.
+class GameIdCache {
+public:
+    static const size_t kDefaultCapacity = 256;
+
+    // An empty path keeps the cache in memory only.
+    explicit GameIdCache(const std::string& path = std::string(), size_t capacity = kDefaultCapacity)
+        : m_path(path)
+        , m_cache(capacity)
+    {
+    }
+
+    // The file is read the first time a game is looked up.
+    bool find(const std::string& game, std::string& id);
+    void set(const std::string& game, const std::string& id);
+
+    // Writes the file if anything was added since it was loaded or last saved.
+    bool save();
+
+private:
+    void loadIfNeeded();
+
+    const std::string m_path;
+    std::mutex m_mutex;
+    bool m_loaded = false;
+    bool m_changed = false;
+    LruCache<std::string, std::string> m_cache;
+};
+
+}  // namespace twitchsw
@@ -0,0 +1,144 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <twitchsw/gamecatalog.h>
+#include <twitchsw/trigramindex.h>
+
+namespace twitchsw {
+
+// A game returned by a typeahead search.
+struct GameSuggestion {
+    std::string name;
+
+    // Zero if the API does not report popularity.
+    uint64_t popularity = 0;
+};
+
+// Remembers the games returned by typeahead searches, so that queries which
+// were searched for before, or which extend a search that returned every game
+// it matched, are answered without going to the network. Searches return a
+// page of games at most, so one which filled its page says nothing about the
+// games which extensions of its query would find.
+//
+// Every word of a game's name is a key, so "over" finds both "Overwatch" and
+// "Game Over". Keys are kept in one sorted array, and a prefix query is a binary
+// search followed by a scan of the matching range.
+//
+// Games from earlier sessions are kept in a GameCatalog, which is mapped the
+// first time the index is searched. Games found since then are kept in memory
+// until save() merges them into the catalog.
+//
+// Searched from the main thread when the properties are built, and filled in on
+// the WorkerThread, so all state is guarded by a mutex.
+class GameIndex {
+public:
+    static const size_t kDefaultCapacity = 4096;
+    static const size_t kDefaultLimit = 10;
+
+    // When the catalog grows past this, the least popular games are dropped.
+    static const size_t kCatalogCapacity = 65536;
+
+    // An empty path keeps the index in memory only.
+    explicit GameIndex(const std::string& catalogPath = std::string(), size_t capacity = kDefaultCapacity)
+        : m_catalogPath(catalogPath)
+        , m_capacity(capacity ? capacity : 1)
+    {
+    }
+
+    // Records the results of searching for `query`, in the order the API ranked
+    // them. `complete` is set if the search returned less than a full page, see
+    // ChannelApi::isCompleteSearch(). If the games kept in memory would exceed
+    // the capacity, they are emptied first.
+    void add(const std::string& query, const std::vector<GameSuggestion>& games, bool complete);
+
+    // Fills `names` with up to `limit` games which have a word starting with
+    // `query`, most popular first. Returns false on a miss, which the caller
+    // should send to the network: unless `query` itself was searched for, or
+    // extends a complete search, it needs an earlier search for a prefix of it
+    // and `limit` games which match.
+    bool find(const std::string& query, std::vector<std::string>& names, size_t limit = kDefaultLimit) const;
+
+    // Returns true if a search found a game named `name`, ignoring case and
+    // punctuation, and sets `canonical` to the name as the API spells it.
+    bool resolve(const std::string& name, std::string& canonical) const;
+
+    // Fills `names` with up to `limit` known games which look like a misspelling
+    // of `name`, best match first. Returns false if there are none.
+    //
+    // resolve() and findSimilar() need a trigram index of every known game, and
+    // return false until buildSimilarityIndex() has built it.
+    bool findSimilar(const std::string& name, std::vector<std::string>& names, size_t limit = 1) const;
+
+    // Builds the index behind resolve() and findSimilar(), if it wasn't built
+    // yet. add() keeps it up to date after that. Only the thread which adds
+    // games may call this, and searches aren't held up while it runs.
+    void buildSimilarityIndex();
+
+    // The number of games added since the catalog was last saved.
+    size_t size() const;
+    void clear();
+
+    // Merges the games kept in memory into the catalog, and rewrites the file.
+    // Only the thread which adds games may call this. Returns false if the
+    // catalog could not be written.
+    bool save();
+
+    // Lowercases ASCII letters, and turns each run of ASCII punctuation and
+    // whitespace into a single space. Other bytes are kept as they are.
+    static std::string normalize(const std::string& name);
+
+private:
+    typedef GameCatalog::Game Game;
+
+    struct Key {
+        std::string word;
+        size_t game;
+    };
+
+    // Must be called with m_mutex held.
+    bool hasSearched(const std::string& normalizedQuery, bool& complete) const;
+    // Sets `covered` if one of the searches for a prefix of the query, or for
+    // the query itself, was complete.
+    bool hasSearchedPrefix(const std::string& normalizedQuery, bool& covered) const;
+    void openCatalogIfNeeded() const;
+    void clearLocked();
+
+    struct SimilarityIndex {
+        TrigramIndex trigrams;
+        std::vector<std::string> names;
+        std::unordered_map<std::string, size_t> ids;
+
+        void add(const std::string& name, const std::string& folded);
+    };
+
+    const std::string m_catalogPath;
+    size_t m_capacity;
+    mutable std::mutex m_mutex;
+    mutable GameCatalog m_catalog;
+    mutable bool m_didOpenCatalog = false;
+
+    std::vector<Game> m_games;
+    std::unordered_map<std::string, size_t> m_gameIndex;
+
+    // Sorted by word.
+    std::vector<Key> m_keys;
+
+    // Normalized queries which were searched for, sorted.
+    std::vector<GameCatalog::Query> m_queries;
+
+    // Every known game, from the catalog and from this session, by trigram id.
+    bool m_didBuildSimilarityIndex = false;
+    mutable SimilarityIndex m_similar;
+};
+
+}  // namespace twitchsw
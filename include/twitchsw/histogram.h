@@ -0,0 +1,52 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace twitchsw {
+
+// Fixed-size latency histogram with power-of-two microsecond buckets. Bucket 0
+// counts samples under 1us, and bucket N counts samples in [2^(N-1), 2^N) us,
+// so percentiles are accurate to within a factor of two. Recording is O(1) and
+// never allocates.
+//
+// Histogram is not thread-safe.
+class Histogram {
+public:
+    typedef std::chrono::microseconds Duration;
+
+    static const unsigned kBuckets = 32;
+
+    template <typename Rep, typename Period>
+    void record(const std::chrono::duration<Rep, Period>& value) {
+        record(std::chrono::duration_cast<Duration>(value));
+    }
+    void record(Duration value);
+
+    void merge(const Histogram& other);
+    void reset() { *this = Histogram(); }
+
+    uint64_t count() const { return m_count; }
+    uint64_t bucketCount(unsigned bucket) const { return m_buckets[bucket]; }
+    Duration max() const { return Duration(m_max); }
+    Duration mean() const { return Duration(m_count ? m_sum / m_count : 0); }
+
+    // Upper bound of the bucket holding the given percentile (0.0 - 1.0), clamped
+    // to the largest recorded value.
+    Duration percentile(double p) const;
+
+    static unsigned bucketForValue(uint64_t microseconds);
+
+private:
+    uint64_t m_buckets[kBuckets] = {};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_max = 0;
+};
+
+}  // namespace twitchsw
@@ -5,8 +5,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <list>
+#include <memory>
 #include <string>
 
 #include <twitchsw/map.h>
@@ -26,6 +28,10 @@ public:
         : m_status(status)
         , m_content(content)
     {}
+    explicit HttpResponse(int status, std::string&& content)
+        : m_status(status)
+        , m_content(std::move(content))
+    {}
     explicit HttpResponse(int status)
         : m_status(status)
         , m_content("")
@@ -59,6 +65,10 @@ struct URLQueryParameter {
 
 typedef std::function<OnRedirect(const std::string& url, const std::string& content)> OnRedirectCallback;
 
+// Set from any thread to abort a request which is in progress. The aborted request
+// returns a status of -1.
+typedef std::shared_ptr<std::atomic<bool>> HttpCancelFlag;
+
 class Http;
 class HttpRequestOptions {
 public:
@@ -67,6 +77,7 @@ public:
     HttpResponse get(const std::string& url);
     HttpResponse put(const std::string& url, const std::string& body);
     HttpResponse put(const std::string& url, const void* data, size_t length);
+    HttpResponse patch(const std::string& url, const std::string& body);
 
     HttpRequestOptions& setHeader(const std::string& key, const std::string& value) {
         insertOrAssign(m_headers, key, value);
@@ -90,6 +101,11 @@ public:
     }
     const OnRedirectCallback& onRedirect() const { return m_onRedirect; }
 
+    HttpRequestOptions& setCancelFlag(const HttpCancelFlag& flag) {
+        m_cancelFlag = flag;
+        return *this;
+    }
+
 private:
     friend class WebView;
     friend class WebViewImpl;
@@ -114,6 +130,7 @@ private:
     std::map<std::string, std::string> m_headers;
     std::list<URLQueryParameter> m_parameters;
     OnRedirectCallback m_onRedirect;
+    HttpCancelFlag m_cancelFlag;
 };
 
 class Http {
@@ -121,6 +138,7 @@ public:
     static void Shutdown();
     static HttpResponse GET(const std::string& url, const HttpRequestOptions& options);
     static HttpResponse PUT(const std::string& url, const std::string& body, const HttpRequestOptions& options);
+    static HttpResponse PATCH(const std::string& url, const std::string& body, const HttpRequestOptions& options);
 
     HttpResponse get(const std::string& url, HttpRequestOptions& options) {
         return Http::GET(url, options.mergeHeaders(m_defaultHeaders));
@@ -130,6 +148,10 @@ public:
         return Http::PUT(url, body, options.mergeHeaders(m_defaultHeaders));
     }
 
+    HttpResponse patch(const std::string& url, const std::string& body, HttpRequestOptions& options) {
+        return Http::PATCH(url, body, options.mergeHeaders(m_defaultHeaders));
+    }
+
     Http& setHeader(const std::string& name, const std::string& value) {
         m_defaultHeaders[name] = value;
         return *this;
@@ -151,5 +173,8 @@ inline HttpResponse HttpRequestOptions::put(const std::string& url, const std::s
 inline HttpResponse HttpRequestOptions::put(const std::string& url, const void* data, size_t length) {
     return put(url, std::string(static_cast<const char*>(data), length));
 }
+inline HttpResponse HttpRequestOptions::patch(const std::string& url, const std::string& body) {
+    return m_http->patch(url, body, *this);
+}
 
 }  // namespace twitchsw
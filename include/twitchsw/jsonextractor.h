@@ -0,0 +1,70 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <twitchsw/string.h>
+
+namespace twitchsw {
+
+// Pulls a few members out of a JSON response without building a document. The
+// response is read with a SAX reader, which stops as soon as every requested
+// member has been seen, so the rest of a large response is never looked at.
+//
+// Only members of the top-level object are visible. Strings are captured as-is
+// and numbers as their decimal text; any other value leaves the target null.
+//
+// The response is copied once and parsed in place. Captured strings share that
+// copy rather than each being copied out of it, so any of them keeps the whole
+// copy alive.
+//
+//     String name, id;
+//     JsonExtractor extractor;
+//     extractor.field("display_name", name).field("_id", id);
+//     extractor.parse(response.content());
+class JsonExtractor {
+public:
+    typedef std::function<void(const std::vector<String>& values)> RowCallback;
+
+    JsonExtractor& field(const char* key, String& value);
+
+    // Calls `callback` for each of the first `limit` objects in the array member
+    // `arrayKey`, with the members named by `keys` in the same order.
+    JsonExtractor& forEach(const char* arrayKey, std::vector<const char*> keys, RowCallback callback,
+                           size_t limit = SIZE_MAX);
+
+    // Returns false if the response is not a JSON object, or is malformed before
+    // everything requested was found. Fields found before the error are kept.
+    bool parse(const std::string& json);
+
+private:
+    class Handler;
+    friend class Handler;
+
+    struct Field {
+        const char* key;
+        String* value;
+        bool found;
+    };
+
+    struct Array {
+        const char* key;
+        std::vector<const char*> keys;
+        RowCallback callback;
+        size_t limit;
+        bool found;
+    };
+
+    std::vector<Field> m_fields;
+    std::vector<Array> m_arrays;
+};
+
+}  // namespace twitchsw
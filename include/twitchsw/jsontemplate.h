@@ -0,0 +1,105 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace twitchsw {
+
+// Number of bytes `characters` takes up once escaped for a JSON string, and the
+// escaping itself, which writes exactly that many bytes to `out` and returns the
+// end. Escapes the same characters as rapidjson's Writer: quotes, backslashes
+// and control characters. Other bytes, including UTF-8 sequences, are copied.
+size_t jsonEscapedLength(const char* characters, size_t length);
+char* writeJsonEscaped(char* out, const char* characters, size_t length);
+
+// Serializes request bodies whose shape never changes: an object of string
+// members, wrapped in a fixed prefix and suffix. Everything but the values is
+// known at compile time, so rendering measures the escaped values, allocates the
+// body once at its exact size, and copies the pieces in.
+//
+// Members with empty values are left out, as the APIs treat a missing member as
+// "leave unchanged". Keys are written as-is, so must not need escaping.
+//
+//     static constexpr JsonTemplate<2> kBody("{\"channel\":{", { "game", "status" }, "}}");
+//     std::string body = kBody.render(game, title);
+template <size_t MemberCount>
+class JsonTemplate {
+public:
+    constexpr JsonTemplate(const char* prefix, const char* const (&keys)[MemberCount], const char* suffix)
+        : m_prefix(prefix)
+        , m_prefixLength(length(prefix))
+        , m_suffix(suffix)
+        , m_suffixLength(length(suffix))
+    {
+        for (size_t i = 0; i < MemberCount; ++i) {
+            m_keys[i] = keys[i];
+            m_keyLengths[i] = length(keys[i]);
+        }
+    }
+
+    // Takes one value per key, in the same order.
+    template <typename... Values>
+    std::string render(const Values&... values) const {
+        static_assert(sizeof...(Values) == MemberCount, "JsonTemplate::render() takes one value per member");
+        const std::string* strings[] = { &values... };
+
+        size_t escapedLengths[MemberCount];
+        size_t size = m_prefixLength + m_suffixLength;
+        bool first = true;
+        for (size_t i = 0; i < MemberCount; ++i) {
+            if (strings[i]->empty())
+                continue;
+            escapedLengths[i] = jsonEscapedLength(strings[i]->data(), strings[i]->length());
+            // [,]"key":"value"
+            size += (first ? 0 : 1) + m_keyLengths[i] + escapedLengths[i] + 5;
+            first = false;
+        }
+
+        std::string result(size, '\0');
+        char* out = &result[0];
+        out = copy(out, m_prefix, m_prefixLength);
+        first = true;
+        for (size_t i = 0; i < MemberCount; ++i) {
+            if (strings[i]->empty())
+                continue;
+            if (!first)
+                *out++ = ',';
+            first = false;
+            *out++ = '"';
+            out = copy(out, m_keys[i], m_keyLengths[i]);
+            out = copy(out, "\":\"", 3);
+            out = writeJsonEscaped(out, strings[i]->data(), strings[i]->length());
+            *out++ = '"';
+        }
+        copy(out, m_suffix, m_suffixLength);
+        return result;
+    }
+
+private:
+    static constexpr size_t length(const char* string) {
+        size_t result = 0;
+        while (string[result])
+            ++result;
+        return result;
+    }
+
+    static char* copy(char* out, const char* characters, size_t length) {
+        std::memcpy(out, characters, length);
+        return out + length;
+    }
+
+    const char* m_prefix;
+    size_t m_prefixLength;
+    const char* m_suffix;
+    size_t m_suffixLength;
+    const char* m_keys[MemberCount] {};
+    size_t m_keyLengths[MemberCount] {};
+};
+
+}  // namespace twitchsw
@@ -0,0 +1,87 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace twitchsw {
+
+// A map which holds at most `capacity` entries, evicting the least recently used
+// entry to make room. Lookups and insertions are O(1). Not thread-safe.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+public:
+    explicit LruCache(size_t capacity)
+        : m_capacity(capacity ? capacity : 1)
+    {
+    }
+
+    size_t size() const { return m_entries.size(); }
+    size_t capacity() const { return m_capacity; }
+    bool isEmpty() const { return m_entries.empty(); }
+
+    // Marks the entry as most recently used.
+    bool get(const Key& key, Value& value) {
+        auto it = m_index.find(key);
+        if (it == m_index.end())
+            return false;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        value = it->second->second;
+        return true;
+    }
+
+    bool contains(const Key& key) const { return m_index.find(key) != m_index.end(); }
+
+    // Inserts or replaces the entry, and marks it as most recently used.
+    void put(const Key& key, const Value& value) {
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            it->second->second = value;
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return;
+        }
+        if (m_entries.size() >= m_capacity) {
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+        m_entries.emplace_front(key, value);
+        m_index[key] = m_entries.begin();
+    }
+
+    bool erase(const Key& key) {
+        auto it = m_index.find(key);
+        if (it == m_index.end())
+            return false;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+        return true;
+    }
+
+    void clear() {
+        m_index.clear();
+        m_entries.clear();
+    }
+
+    // Visits entries from least to most recently used, so that putting them into
+    // an empty cache in the same order restores the same recency.
+    template <typename Function>
+    void forEach(Function function) const {
+        for (auto it = m_entries.rbegin(); it != m_entries.rend(); ++it)
+            function(it->first, it->second);
+    }
+
+private:
+    typedef std::list<std::pair<Key, Value>> EntryList;
+
+    size_t m_capacity;
+    EntryList m_entries;
+    std::unordered_map<Key, typename EntryList::iterator, Hash> m_index;
+};
+
+}  // namespace twitchsw
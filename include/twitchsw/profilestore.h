@@ -0,0 +1,63 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace twitchsw {
+
+// Keeps each profile's access token and channel on disk between sessions, so that
+// the first update after OBS starts does not have to sign in again.
+//
+// The file holds credentials, so it is only readable by the current user. Not
+// thread-safe: the WorkerThread owns the store, and only uses it on the worker.
+class ProfileStore {
+public:
+    struct Entry {
+        std::string accessToken;
+        std::string channelName;
+        std::string channelId;
+
+        bool operator==(const Entry& other) const {
+            return accessToken == other.accessToken && channelName == other.channelName && channelId == other.channelId;
+        }
+        bool operator!=(const Entry& other) const { return !(*this == other); }
+    };
+
+    // An empty path disables the store: nothing is loaded or saved.
+    explicit ProfileStore(const std::string& path = std::string())
+        : m_path(path)
+    {
+    }
+
+    const std::string& path() const { return m_path; }
+
+    // The file is read the first time a profile is looked up.
+    bool find(const std::string& profile, Entry& entry);
+    std::vector<std::string> profiles();
+
+    // Entries without an access token are removed. Changes are kept in memory
+    // until save().
+    void set(const std::string& profile, const Entry& entry);
+
+    // Writes the file if anything changed since it was loaded or last saved.
+    // Returns false if the file could not be written.
+    bool save();
+
+private:
+    void loadIfNeeded();
+    static bool parse(const std::string& json, std::map<std::string, Entry>& entries);
+    static std::string serialize(const std::map<std::string, Entry>& entries);
+
+    std::string m_path;
+    bool m_loaded = false;
+    bool m_changed = false;
+    std::map<std::string, Entry> m_entries;
+};
+
+}  // namespace twitchsw
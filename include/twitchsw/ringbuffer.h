@@ -0,0 +1,120 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace twitchsw {
+
+// Double-ended queue over a preallocated circular buffer. Unlike std::list or
+// std::deque, pushing and popping never allocate until the reserved capacity is
+// exceeded, at which point the buffer doubles in size.
+//
+// Popped elements are reset to T(), so that resources they own are released
+// immediately rather than when the slot is next overwritten.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 0)
+        : m_buffer(capacity)
+    {
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_buffer.size(); }
+    bool empty() const { return !m_size; }
+
+    T& operator[](size_t index) { return m_buffer[physicalIndex(index)]; }
+    const T& operator[](size_t index) const { return m_buffer[physicalIndex(index)]; }
+
+    T& front() { return m_buffer[m_head]; }
+    const T& front() const { return m_buffer[m_head]; }
+    T& back() { return (*this)[m_size - 1]; }
+    const T& back() const { return (*this)[m_size - 1]; }
+
+    void pushBack(T&& value)
+    {
+        growIfNeeded();
+        m_buffer[physicalIndex(m_size)] = std::move(value);
+        ++m_size;
+    }
+
+    void pushFront(T&& value)
+    {
+        growIfNeeded();
+        m_head = m_head ? m_head - 1 : m_buffer.size() - 1;
+        m_buffer[m_head] = std::move(value);
+        ++m_size;
+    }
+
+    void popFront()
+    {
+        assert(m_size);
+        m_buffer[m_head] = T();
+        m_head = physicalIndex(1);
+        --m_size;
+    }
+
+    // Removes the element at `index`, shifting later elements down.
+    void erase(size_t index)
+    {
+        assert(index < m_size);
+        for (size_t i = index + 1; i < m_size; ++i)
+            (*this)[i - 1] = std::move((*this)[i]);
+        (*this)[m_size - 1] = T();
+        --m_size;
+    }
+
+    void clear()
+    {
+        while (m_size)
+            popFront();
+        m_head = 0;
+    }
+
+    void reserve(size_t capacity)
+    {
+        if (capacity <= m_buffer.size())
+            return;
+        std::vector<T> buffer(capacity);
+        for (size_t i = 0; i < m_size; ++i)
+            buffer[i] = std::move((*this)[i]);
+        m_buffer.swap(buffer);
+        m_head = 0;
+    }
+
+    void swap(RingBuffer& other)
+    {
+        m_buffer.swap(other.m_buffer);
+        std::swap(m_head, other.m_head);
+        std::swap(m_size, other.m_size);
+    }
+
+private:
+    size_t physicalIndex(size_t index) const
+    {
+        size_t result = m_head + index;
+        return result >= m_buffer.size() ? result - m_buffer.size() : result;
+    }
+
+    void growIfNeeded()
+    {
+        if (m_size == m_buffer.size())
+            reserve(m_buffer.empty() ? 4 : m_buffer.size() * 2);
+    }
+
+    std::vector<T> m_buffer;
+    size_t m_head = 0;
+    size_t m_size = 0;
+};
+
+}  // namespace twitchsw
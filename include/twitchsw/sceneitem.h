@@ -7,10 +7,12 @@
 
 #include <list>
 #include <mutex>
+#include <string>
 
 #include <obs.hpp>
 #include <obs-source.h>
 
+#include <twitchsw/atomstring.h>
 #include <twitchsw/string.h>
 
 namespace twitchsw {
@@ -31,8 +33,19 @@ public:
     void didLoadProperties(obs_data_t* settings);
     void updateGameTitleTypeahead(obs_data_t* settings);
 
-    String game() const { return m_game; }
-    String title() const { return m_title; }
+    // Replaces the game with the suggestion offered by the properties. Returns
+    // true if the properties should be rebuilt.
+    bool acceptGameCorrection();
+
+    String game() const { return m_game.string(); }
+    String title() const { return m_title.string(); }
+
+    // Comma-separated ChannelProfile names to update when this item is shown.
+    String profiles() const { return m_profiles.string(); }
+
+    // Copies the settings which an update needs. Unlike the accessors above,
+    // this may be called from the WorkerThread.
+    void snapshot(std::string& game, std::string& title, std::string& profiles) const;
 
     template <typename T>
     struct Setting {
@@ -46,8 +59,18 @@ public:
     static TSWSceneItem* fromSceneItem(obs_sceneitem_t* item);
 private:
     obs_source_t* m_source;
-    String m_game;
-    String m_title;
+
+    // Settings are only written on the main thread, and read under the lock
+    // from other threads. Interned, so that noticing which ones changed is a
+    // pointer comparison.
+    mutable std::mutex m_settingsMutex;
+    AtomString m_game;
+    AtomString m_title;
+    AtomString m_profiles;
+
+    // The game offered by the properties in place of a misspelled one. Only
+    // accessed from the main thread.
+    std::string m_gameCorrection;
 };
 
 }  // namespace twitchsw
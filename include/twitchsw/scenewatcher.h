@@ -12,6 +12,7 @@
 namespace twitchsw {
 
 class SceneWatcherImpl;
+class UpdateEvent;
 class SceneWatcher {
 public:
     SceneWatcher();
@@ -20,8 +21,14 @@ public:
     void start();
     void terminate();
 
+    // These are called from the WorkerThread, and are safe to call while the
+    // SceneWatcher is being terminated.
     static bool getTwitchCredentials(String& key);
 
+    // Returns false if the update should be dropped, e.g. because the stream
+    // is not live, or because the output which started is not the Twitch stream.
+    static bool shouldUpdate(const UpdateEvent& event);
+
 private:
     SceneWatcherImpl* m_impl = nullptr;
 };
@@ -0,0 +1,77 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace twitchsw {
+
+// Fixed set of preallocated object slots, for objects which are created on one
+// thread and destroyed on another at a high rate (such as EventData handed to the
+// WorkerThread). Slots are recycled through a free-list, and allocation only
+// falls back to the heap once every slot is in use.
+//
+// Intended to back class-specific operator new / operator delete.
+template <size_t SlotSize, size_t SlotCount>
+class SlotPool {
+public:
+    SlotPool()
+    {
+        for (size_t i = 0; i < SlotCount; ++i)
+            m_free[i] = static_cast<unsigned>(SlotCount - 1 - i);
+    }
+
+    SlotPool(const SlotPool&) = delete;
+    SlotPool& operator=(const SlotPool&) = delete;
+
+    void* allocate(size_t size)
+    {
+        if (size <= SlotSize) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_freeCount)
+                return &m_slots[m_free[--m_freeCount]];
+            ++m_misses;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* ptr)
+    {
+        if (!owns(ptr)) {
+            ::operator delete(ptr);
+            return;
+        }
+        unsigned index = static_cast<unsigned>(static_cast<Slot*>(ptr) - m_slots);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free[m_freeCount++] = index;
+    }
+
+    bool owns(const void* ptr) const
+    {
+        return ptr >= static_cast<const void*>(m_slots) && ptr < static_cast<const void*>(m_slots + SlotCount);
+    }
+
+    // Number of allocations which could not be satisfied by the pool.
+    size_t misses()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_misses;
+    }
+
+private:
+    typedef typename std::aligned_storage<SlotSize, alignof(std::max_align_t)>::type Slot;
+
+    std::mutex m_mutex;
+    Slot m_slots[SlotCount];
+    unsigned m_free[SlotCount];
+    size_t m_freeCount = SlotCount;
+    size_t m_misses = 0;
+};
+
+}  // namespace twitchsw
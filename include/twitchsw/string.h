@@ -11,6 +11,7 @@
 
 #include <string>
 #include <cstdlib>
+#include <functional>
 
 namespace twitchsw {
 
@@ -75,6 +76,10 @@ public:
     unsigned refCount() const { return m_impl ? m_impl->refCount() : 0; }
 
     StringImpl* impl() const { return m_impl.get(); }
+
+    // Cached by the StringImpl. Null and empty strings hash alike, as they
+    // compare equal.
+    unsigned hash() const { return (m_impl ? m_impl.get() : StringImpl::empty())->hash(); }
     RefPtr<StringImpl> releaseImpl() { return std::move(m_impl); }
 
     std::string toStdString() const {
@@ -202,4 +207,34 @@ private:
     RefPtr<StringImpl> m_impl;
 };
 
+// Strings which both cached different hashes can't be equal, which spares
+// comparing their characters.
+inline bool operator==(const String& a, const String& b)
+{
+    StringImpl* aImpl = a.impl();
+    StringImpl* bImpl = b.impl();
+    if (aImpl == bImpl)
+        return true;
+    if (a.length() != b.length())
+        return false;
+    if (aImpl && bImpl) {
+        unsigned aHash = aImpl->existingHash();
+        unsigned bHash = bImpl->existingHash();
+        if (aHash && bHash && aHash != bHash)
+            return false;
+    }
+    return a.equals(b);
+}
+
+inline bool operator!=(const String& a, const String& b) { return !(a == b); }
+
+// For unordered containers of Strings.
+struct StringHash {
+    size_t operator()(const String& string) const { return string.hash(); }
+};
+
 }  // twitchsw
+
+namespace std {
+template <> struct hash<twitchsw::String> : twitchsw::StringHash { };
+}  // namespace std
@@ -0,0 +1,54 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstdint>
+
+namespace twitchsw {
+
+// Scheduling parameters for background threads, so that they yield to the OBS
+// render, audio and encoder threads.
+struct ThreadScheduling {
+    enum class Policy {
+        // Leave the thread at the priority it was created with.
+        Default,
+
+        // Linux: SCHED_BATCH. Mac: QOS_CLASS_UTILITY. Windows: below normal.
+        Batch,
+
+        // Linux: SCHED_IDLE. Mac: QOS_CLASS_BACKGROUND. Windows: lowest.
+        // The thread may be starved for as long as every core is busy.
+        Idle
+    };
+
+    ThreadScheduling()
+        : policy(Policy::Default)
+        , niceLevel(0)
+        , affinityMask(0)
+    {
+    }
+
+    Policy policy;
+
+    // Linux only: per-thread nice level, from -20 to 19. 0 leaves it unchanged.
+    int niceLevel;
+
+    // Bit N allows the thread to run on logical CPU N. 0 leaves the affinity
+    // unchanged. Not supported on Mac, which has no hard affinity API.
+    uint64_t affinityMask;
+};
+
+// Applies `scheduling` to the calling thread. Returns false if any part of it
+// could not be applied; whatever could be applied is kept.
+bool applyCurrentThreadScheduling(const ThreadScheduling& scheduling);
+
+// Names the calling thread for debuggers and profilers. Names longer than 15
+// characters are truncated on Linux.
+void setCurrentThreadName(const char* name);
+
+const char* threadSchedulingPolicyName(ThreadScheduling::Policy policy);
+
+}  // namespace twitchsw
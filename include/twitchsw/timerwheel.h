@@ -0,0 +1,116 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include <twitchsw/refs.h>
+
+namespace twitchsw {
+
+// Hierarchical timer wheel, used to schedule delayed and periodic work on the
+// WorkerThread.
+//
+// Timers are bucketed by expiration tick into kLevels wheels of kSlotsPerLevel
+// slots. A slot in level N covers kSlotsPerLevel^N ticks, and timers are
+// cascaded into lower levels as the wheel turns. Scheduling and cancelling are
+// O(1), and finding the next deadline only inspects one occupancy bitmap per
+// level, so the owning thread can block with a single timed wait.
+//
+// TimerWheel is not thread-safe, and must only be used from the thread which
+// advances it.
+class TimerWheel {
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef Clock::time_point TimePoint;
+    typedef Clock::duration Duration;
+    typedef std::function<void()> Callback;
+
+    static const unsigned kLevelBits = 6;
+    static const unsigned kSlotsPerLevel = 1 << kLevelBits;
+    static const unsigned kLevels = 4;
+
+    class Timer : public RefCounted<Timer> {
+    public:
+        bool isScheduled() const { return m_wheel != nullptr; }
+        bool isRepeating() const { return m_period > Duration::zero(); }
+        bool isCancelled() const { return m_cancelled; }
+
+    private:
+        friend class TimerWheel;
+        Timer(Callback&& callback, Duration period)
+            : m_period(period)
+            , m_callback(std::move(callback))
+        {
+        }
+
+        TimerWheel* m_wheel = nullptr;
+        Timer* m_prev = nullptr;
+        Timer* m_next = nullptr;
+        uint64_t m_expiration = 0;
+        uint8_t m_level = 0;
+        uint8_t m_slot = 0;
+        bool m_cancelled = false;
+        Duration m_period;
+        Callback m_callback;
+    };
+
+    explicit TimerWheel(Duration tick = std::chrono::milliseconds(10), TimePoint epoch = Clock::now());
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Schedules `callback` to run once `deadline` has passed. If `period` is
+    // non-zero, the timer is re-armed every `period` after that until cancelled.
+    Ref<Timer> schedule(TimePoint deadline, Callback callback, Duration period = Duration::zero());
+
+    Ref<Timer> scheduleAfter(Duration delay, Callback callback) {
+        return schedule(Clock::now() + delay, std::move(callback));
+    }
+    Ref<Timer> scheduleRepeating(Duration period, Callback callback) {
+        return schedule(Clock::now() + period, std::move(callback), period);
+    }
+
+    // Prevents the timer from firing again. Safe to call from within the timer's
+    // own callback. Returns false if the timer was already cancelled.
+    bool cancel(Timer& timer);
+
+    // Runs the callbacks of every timer whose deadline is at or before `now`, and
+    // returns the number of callbacks run.
+    size_t advance(TimePoint now);
+
+    // Returns false if no timers are scheduled. Otherwise, sets `deadline` to the
+    // next time at which advance() has work to do.
+    bool nextDeadline(TimePoint& deadline) const;
+
+    bool isEmpty() const { return !m_count; }
+    size_t size() const { return m_count; }
+    Duration tick() const { return m_tick; }
+
+private:
+    static const unsigned kSlotMask = kSlotsPerLevel - 1;
+
+    uint64_t tickFloor(TimePoint time) const;
+    uint64_t tickCeil(TimePoint time) const;
+    uint64_t nextTick() const;
+
+    void link(Timer* timer);
+    void unlink(Timer* timer);
+    void cascade();
+    size_t fireSlot(unsigned slot);
+
+    Duration m_tick;
+    TimePoint m_epoch;
+    uint64_t m_current = 0;
+    size_t m_count = 0;
+    uint64_t m_occupied[kLevels] = { };
+    Timer* m_slots[kLevels][kSlotsPerLevel] = { };
+};
+
+}  // namespace twitchsw
@@ -0,0 +1,61 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace twitchsw {
+
+// Finds the strings which look most like a misspelled query, by the trigrams
+// (three byte substrings) which they share with it.
+//
+// Each trigram maps to the sorted list of strings which contain it. A search
+// walks the lists of the query's trigrams, counting hits per string, so the
+// cost depends on how common the query's trigrams are rather than on the number
+// of strings. Not thread-safe.
+class TrigramIndex {
+public:
+    // The Dice coefficient below which a string is not considered similar.
+    // Roughly one typo in a ten letter name.
+    static constexpr double kDefaultThreshold = 0.5;
+
+    struct Match {
+        size_t id;
+
+        // 2 * shared / (query trigrams + string trigrams), from 0 to 1.
+        double score;
+    };
+
+    // Returns the string's id: the number of strings added before it. Strings
+    // should already be normalized, as matching is exact byte for byte.
+    size_t add(const std::string& text);
+
+    size_t size() const { return m_trigramCounts.size(); }
+    void clear();
+
+    // Up to `limit` strings which score at least `threshold`, best first.
+    std::vector<Match> search(const std::string& query, size_t limit, double threshold = kDefaultThreshold);
+
+    // The distinct trigrams of `text`, padded with a space on either side so that
+    // the first and last letters count as much as the others. Sorted.
+    static void trigrams(const std::string& text, std::vector<uint32_t>& result);
+
+private:
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_postings;
+    std::vector<uint16_t> m_trigramCounts;
+
+    // Scratch space for search(), kept to avoid allocating per query. m_hits has
+    // an entry per string, and is zero outside of search().
+    std::vector<uint8_t> m_hits;
+    std::vector<uint32_t> m_touched;
+    std::vector<uint32_t> m_queryTrigrams;
+};
+
+}  // namespace twitchsw
@@ -5,13 +5,20 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include <twitchsw/twitchsw.h>
+#include <twitchsw/channelapi.h>
 #include <twitchsw/string.h>
+#include <twitchsw/histogram.h>
 #include <twitchsw/refs.h>
+#include <twitchsw/threadscheduling.h>
 
 struct obs_output;
+struct obs_source;
 
 namespace twitchsw {
 
@@ -21,34 +28,34 @@ public:
     virtual ~EventData() {}
 };
 
+// Posted from libobs signal handlers on the main thread when a scene with a
+// TwitchSwitcher item is shown. Only identifies what changed: reading the item's
+// settings and deciding whether to update at all is left to the worker, so that
+// scene switching never waits on plugin work.
 class UpdateEvent : public EventData {
 public:
-    UpdateEvent(String&& scene, String&& game, String&& title)
-        : m_scene(std::move(scene))
-        , m_game(std::move(game))
-        , m_title(std::move(title))
-    {
-    }
-
-    UpdateEvent(const String& scene, const String& game, const String& title)
-        : m_scene(scene)
-        , m_game(game)
-        , m_title(title)
-    {
-    }
-
-    ~UpdateEvent() override
-    {
-    }
+    // Holds a reference to `item` (the TwitchSwitcher source) and `startedOutput`
+    // until the event is destroyed, which may be on the worker thread.
+    UpdateEvent(const String& scene, obs_source* item, obs_output* startedOutput = nullptr);
+    ~UpdateEvent() override;
+
+    // UpdateEvents are allocated from a fixed pool of slots which the worker
+    // recycles, so that posting an update from the main thread does not touch the
+    // heap in steady state.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
 
     String stream() const { return m_scene; }
-    String game() const { return m_game; }
-    String title() const { return m_title; }
+    obs_source* item() const { return m_item; }
+
+    // Set when the update was triggered by a streaming output starting, in which
+    // case it is sent even if the output is not active yet.
+    obs_output* startedOutput() const { return m_startedOutput; }
 
 private:
     String m_scene;
-    String m_game;
-    String m_title;
+    obs_source* m_item;
+    obs_output* m_startedOutput;
 };
 
 class WorkerThreadImpl;
@@ -62,17 +69,144 @@ public:
         kLastPriviledgedMessage = kTerminate,
 
         // Non-priviledged messages pushed to the back and processed in order.
-        kUpdate
+        kUpdate,
+
+        // Runs a task posted through the worker's Executor. Tasks are never
+        // coalesced, and do not count against the capacity.
+        kTask,
+        kLastMessage = kTask
+    };
+    static const unsigned kMessageCount = kLastMessage + 1;
+
+    static const char* messageName(Message message);
+
+    // What to do with a non-priviledged message when the message queue is full.
+    enum class OverflowPolicy {
+        // Discard the oldest pending Update message to make room.
+        DropOldestUpdate,
+
+        // Replace the payload of a pending Update message with the new one, so
+        // that at most one Update is ever queued. Only the most recent scene
+        // matters once the worker catches up.
+        Coalesce,
+
+        // Discard the new message.
+        Reject
+    };
+
+    struct QueueOptions {
+        QueueOptions()
+            : capacity(16)
+            , policy(OverflowPolicy::Coalesce)
+            , metricsLogInterval(std::chrono::minutes(5))
+        {
+        }
+
+        // Clamped to kMaxCapacity, which the pool that update events are
+        // allocated from is sized for.
+        static const size_t kMaxCapacity = 64;
+        size_t capacity;
+        OverflowPolicy policy;
+
+        // How often queue metrics are written to the OBS log, if any messages
+        // were handled since the last time. Zero disables periodic logging.
+        std::chrono::seconds metricsLogInterval;
+    };
+
+    struct AuthOptions {
+        AuthOptions()
+            : validationUrl("https://id.twitch.tv/oauth2/validate")
+            , validationInterval(std::chrono::hours(1))
+            , refreshMargin(std::chrono::hours(24))
+            , api(ChannelApi::Kind::Kraken)
+        {
+        }
+
+        // Where profiles' credentials are kept between sessions. Empty disables
+        // saving them.
+        std::string profileStorePath;
+
+        // Access tokens are checked against `validationUrl` when the worker starts,
+        // and every `validationInterval` after that. Zero disables validation.
+        std::string validationUrl;
+        std::chrono::seconds validationInterval;
+
+        // A token which was rejected, or which expires within `refreshMargin`, is
+        // replaced by signing in again before the next update needs it.
+        std::chrono::seconds refreshMargin;
+
+        // Where channel updates are sent. An empty `apiBaseUrl` uses the API's
+        // default, and can be pointed at a local stand-in server for testing.
+        ChannelApi::Kind api;
+        std::string apiBaseUrl;
+
+        // Where game IDs resolved for the ID-based API are kept between sessions.
+        std::string gameCachePath;
+
+        // Where games found by typeahead searches are kept between sessions.
+        std::string gameCatalogPath;
+    };
+
+    struct QueueStats {
+        size_t depth = 0;
+        size_t highWaterMark = 0;
+        size_t capacity = 0;
+        uint64_t dropped = 0;
+        uint64_t coalesced = 0;
+        uint64_t rejected = 0;
+    };
+
+    // Latencies for one message type, measured from the time it was posted (or,
+    // for a coalesced update, the time its payload was last replaced).
+    struct MessageMetrics {
+        // Posted until picked up by the worker.
+        Histogram queueWait;
+
+        // Time spent in the handler. Updates absorbed by an update which is already
+        // in progress are not counted. An update which waits for sign-in or for
+        // its requests is resumed by kTask messages, which count that time.
+        Histogram processing;
+
+        // Posted until the handler finished. For updates, this is when the update
+        // was sent, or for an absorbed update, when the update which absorbed it
+        // was.
+        Histogram endToEnd;
+    };
+
+    struct Metrics {
+        QueueStats queue;
+        MessageMetrics messages[kMessageCount];
     };
 
     WorkerThread();
     ~WorkerThread();
 
-    void start();
+    // `scheduling` is applied to the worker thread as soon as it starts.
+    void start(const QueueOptions& options = QueueOptions(), const ThreadScheduling& scheduling = ThreadScheduling(),
+               const AuthOptions& auth = AuthOptions());
     void terminate();
 
     // Post an "update" message to the worker thread, if the thread is started.
-    static void update(Ref<UpdateEvent> event);
+    // Returns false if the update was discarded.
+    static bool update(Ref<UpdateEvent> event);
+
+    // Looks up games matching `query` for the properties of `item` (a
+    // TwitchSwitcher source). Queries are debounced, and a query replaces any
+    // earlier one for the same item which has not finished. Results are handed to
+    // the item, and its properties are refreshed. Safe to call from any thread.
+    static void suggestGames(obs_source* item, const std::string& query);
+
+    // Fills `names` with games matching `query` from earlier searches, without
+    // going to the network. Returns false on a miss. Safe to call from any thread.
+    static bool findGames(const std::string& query, std::vector<std::string>& names);
+
+    // Fills `names` with known games which look like a misspelling of `game`.
+    // Returns false if `game` is known, nothing looks like it, or the worker
+    // hasn't indexed the known games yet. Safe to call from any thread.
+    static bool findSimilarGames(const std::string& game, std::vector<std::string>& names);
+
+    static QueueStats queueStats();
+    static Metrics metrics();
 
 private:
     static WorkerThreadImpl* m_impl;
@@ -0,0 +1,136 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/atomstring.h>
+#include <twitchsw/never-destroyed.h>
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace twitchsw {
+
+namespace {
+
+// Refers to the characters of the atom which the entry maps to, so that
+// lookups don't need a StringImpl.
+struct AtomKey {
+    const char* characters;
+    unsigned length;
+    size_t hash;
+};
+
+struct AtomKeyHash {
+    size_t operator()(const AtomKey& key) const { return key.hash; }
+};
+
+struct AtomKeyEqual {
+    bool operator()(const AtomKey& a, const AtomKey& b) const {
+        return a.length == b.length && !std::memcmp(a.characters, b.characters, a.length);
+    }
+};
+
+// Split into independently locked shards, so that threads interning different
+// strings rarely wait for each other.
+class AtomStringTable {
+public:
+    static const size_t kShardCount = 16;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<AtomKey, StringImpl*, AtomKeyHash, AtomKeyEqual> atoms;
+    };
+
+    Shard& shardFor(size_t hash) { return m_shards[(hash >> 16) % kShardCount]; }
+
+    size_t size() {
+        size_t result = 0;
+        for (auto& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            result += shard.atoms.size();
+        }
+        return result;
+    }
+
+private:
+    Shard m_shards[kShardCount];
+};
+
+AtomStringTable& atomStringTable() {
+    static NeverDestroyed<AtomStringTable> table;
+    return table;
+}
+
+}  // namespace
+
+AtomString::AtomString(const char* characters) {
+    if (characters)
+        m_string = add(characters, static_cast<unsigned>(::strlen(characters)));
+}
+
+AtomString::AtomString(const char* characters, unsigned length) {
+    if (characters)
+        m_string = add(characters, length);
+}
+
+AtomString::AtomString(const std::string& string)
+    : m_string(add(string.c_str(), static_cast<unsigned>(string.length())))
+{
+}
+
+AtomString::AtomString(const String& string) {
+    StringImpl* impl = string.impl();
+    if (!impl)
+        return;
+    if (impl->isAtom() || impl->isStatic())
+        m_string = string;
+    else
+        m_string = add(impl->characters(), impl->length());
+}
+
+// static
+RefPtr<StringImpl> AtomString::add(const char* characters, unsigned length) {
+    if (!length)
+        return StringImpl::empty();
+
+    AtomKey key { characters, length, StringImpl::computeHash(characters, length) };
+    auto& shard = atomStringTable().shardFor(key.hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.atoms.find(key);
+    if (it != shard.atoms.end()) {
+        StringImpl* existing = it->second;
+        if (existing->tryRef())
+            return adoptRef(existing);
+        // The last reference is gone, and the atom is waiting for the lock to
+        // remove itself. Replace it, and it will leave the new atom alone.
+        shard.atoms.erase(it);
+    }
+
+    // Atoms always own their characters, rather than keeping a response
+    // buffer or someone else's memory alive.
+    RefPtr<StringImpl> atom = StringImpl::create(characters, length);
+    atom->m_isAtom = true;
+    atom->m_hash.store(static_cast<unsigned>(key.hash), std::memory_order_relaxed);
+    shard.atoms.emplace(AtomKey { atom->characters(), length, key.hash }, atom.get());
+    return atom;
+}
+
+// static
+void AtomString::remove(StringImpl& impl) {
+    // Cached when the atom was added.
+    size_t hash = impl.hash();
+    auto& shard = atomStringTable().shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.atoms.find(AtomKey { impl.characters(), impl.length(), hash });
+    if (it != shard.atoms.end() && it->second == &impl)
+        shard.atoms.erase(it);
+}
+
+// static
+size_t AtomString::tableSize() {
+    return atomStringTable().size();
+}
+
+}  // namespace twitchsw
@@ -0,0 +1,273 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/channelapi.h>
+#include <twitchsw/channelprofile.h>
+#include <twitchsw/gameidcache.h>
+#include <twitchsw/jsonextractor.h>
+#include <twitchsw/jsontemplate.h>
+#include <twitchsw/twitchsw.h>
+
+#include <cstdlib>
+
+namespace twitchsw {
+
+// https://github.com/justintv/Twitch-API/blob/master/v3_resources/channels.md#put-channelschannel
+static constexpr JsonTemplate<2> kKrakenChannelBody("{\"channel\":{", { "game", "status" }, "}}");
+
+// https://dev.twitch.tv/docs/api/reference#modify-channel-information
+static constexpr JsonTemplate<2> kHelixChannelBody("{", { "game_id", "title" }, "}");
+
+// https://dev.twitch.tv/docs/api/reference#search-categories
+static const size_t kHelixSearchPageSize = 20;
+
+class KrakenApi : public ChannelApi {
+public:
+    explicit KrakenApi(const std::string& baseUrl) : ChannelApi(baseUrl) {}
+
+    HttpResponse fetchChannel(const ChannelProfile& profile, std::string& name, std::string& id) override {
+        Http http;
+        setHeaders(http, profile);
+        auto response = http.
+            request().
+            get(m_baseUrl + "/channel");
+        if (!isSuccess(response))
+            return response;
+
+        String displayName, channelId;
+        JsonExtractor extractor;
+        extractor.field("display_name", displayName).field("_id", channelId);
+        if (!extractor.parse(response.content()) || displayName.isNull())
+            return response;
+        name = displayName.toStdString();
+        id = channelId.toStdString();
+        return response;
+    }
+
+    HttpResponse updateChannel(const ChannelProfile& profile, const std::string& channelName, const std::string&,
+                               const std::string& game, const std::string& title) override {
+        Http http;
+        setHeaders(http, profile);
+        return http.
+            request().
+            put(m_baseUrl + "/channels/" + channelName, kKrakenChannelBody.render(game, title));
+    }
+
+    HttpResponse searchGames(const std::string& accessToken, const std::string& query,
+                             const HttpCancelFlag& cancelled, std::vector<GameSuggestion>& games) override {
+        Http http;
+        setHeaders(http, accessToken);
+        auto response = http.
+            request().
+            setParameter("q", query).
+            setParameter("type", "suggest").
+            setCancelFlag(cancelled).
+            get(m_baseUrl + "/search/games");
+        if (!isSuccess(response))
+            return response;
+
+        JsonExtractor extractor;
+        extractor.forEach("games", { "name", "popularity" }, [&](const std::vector<String>& values) {
+            if (values[0].isNull())
+                return;
+            GameSuggestion game;
+            game.name = values[0].toStdString();
+            if (!values[1].isNull())
+                game.popularity = std::strtoull(values[1].c_str(), nullptr, 10);
+            games.push_back(game);
+        });
+        extractor.parse(response.content());
+        return response;
+    }
+
+    bool isCompleteSearch(const std::vector<GameSuggestion>& games) const override {
+        // Suggestions come in a page whose size the API doesn't document, so
+        // only an empty one is known to be every match.
+        return games.empty();
+    }
+
+private:
+    static void setHeaders(Http& http, const ChannelProfile& profile) {
+        setHeaders(http, profile.accessToken());
+    }
+
+    static void setHeaders(Http& http, const std::string& accessToken) {
+        // Searching does not need a token.
+        if (accessToken.length())
+            http.setHeader("Authorization", "OAuth " + accessToken);
+        http.
+            setHeader("Client-Id", TSW_CLIENT_ID).
+            setHeader("Content-Type", "application/json").
+            setHeader("Accept", "application/vnd.twitchtv.v3+json").
+            setHeader("charsets", "utf-8");
+    }
+};
+
+class HelixApi : public ChannelApi {
+public:
+    HelixApi(const std::string& baseUrl, GameIdCache& gameIds)
+        : ChannelApi(baseUrl)
+        , m_gameIds(gameIds)
+    {
+    }
+
+    HttpResponse fetchChannel(const ChannelProfile& profile, std::string& name, std::string& id) override {
+        Http http;
+        setHeaders(http, profile);
+        // Without parameters, describes the user the token belongs to.
+        auto response = http.
+            request().
+            get(m_baseUrl + "/users");
+        if (!isSuccess(response))
+            return response;
+
+        String userId, login;
+        forFirstResult(response, { "id", "login" }, [&](const std::vector<String>& values) {
+            userId = values[0];
+            login = values[1];
+        });
+        if (userId.isEmpty() || login.isNull())
+            return response;
+        id = userId.toStdString();
+        name = login.toStdString();
+        return response;
+    }
+
+    HttpResponse updateChannel(const ChannelProfile& profile, const std::string& channelName, const std::string& channelId,
+                               const std::string& game, const std::string& title) override {
+        Http http;
+        setHeaders(http, profile);
+
+        std::string gameId;
+        if (game.length()) {
+            auto response = resolveGameId(http, game, gameId);
+            if (!isSuccess(response))
+                return response;
+            if (gameId.empty()) {
+                // FIXME: Use obs localization API
+                LOG(LOG_WARNING, "[%s] Unknown game '%s', only updating the title.", profile.name().c_str(), game.c_str());
+            }
+        }
+
+        return http.
+            request().
+            setParameter("broadcaster_id", channelId).
+            patch(m_baseUrl + "/channels", kHelixChannelBody.render(gameId, title));
+    }
+
+    HttpResponse searchGames(const std::string& accessToken, const std::string& query,
+                             const HttpCancelFlag& cancelled, std::vector<GameSuggestion>& games) override {
+        Http http;
+        setHeaders(http, accessToken);
+        auto response = http.
+            request().
+            setParameter("query", query).
+            setParameter("first", std::to_string(kHelixSearchPageSize)).
+            setCancelFlag(cancelled).
+            get(m_baseUrl + "/search/categories");
+        if (!isSuccess(response))
+            return response;
+
+        JsonExtractor extractor;
+        extractor.forEach("data", { "name", "id" }, [&](const std::vector<String>& values) {
+            if (values[0].isNull())
+                return;
+            GameSuggestion game;
+            game.name = values[0].toStdString();
+            games.push_back(game);
+            // Results include IDs, so later updates needn't resolve them again.
+            if (!values[1].isEmpty())
+                m_gameIds.set(game.name, values[1].toStdString());
+        });
+        extractor.parse(response.content());
+        return response;
+    }
+
+    bool isCompleteSearch(const std::vector<GameSuggestion>& games) const override {
+        return games.size() < kHelixSearchPageSize;
+    }
+
+private:
+    static void setHeaders(Http& http, const ChannelProfile& profile) {
+        setHeaders(http, profile.accessToken());
+    }
+
+    static void setHeaders(Http& http, const std::string& accessToken) {
+        http.
+            setHeader("Authorization", "Bearer " + accessToken).
+            setHeader("Client-Id", TSW_CLIENT_ID).
+            setHeader("Content-Type", "application/json");
+    }
+
+    // Responses wrap their results in {"data": [...]}. Reading stops after the
+    // first result.
+    static void forFirstResult(const HttpResponse& response, std::vector<const char*> keys,
+                               JsonExtractor::RowCallback callback) {
+        JsonExtractor extractor;
+        extractor.forEach("data", std::move(keys), std::move(callback), 1);
+        extractor.parse(response.content());
+    }
+
+    // Leaves `id` empty if Twitch does not know the game. Only found games are
+    // cached, so that a game added later is picked up.
+    HttpResponse resolveGameId(Http& http, const std::string& game, std::string& id) {
+        if (m_gameIds.find(game, id))
+            return HttpResponse(200);
+
+        auto response = http.
+            request().
+            setParameter("name", game).
+            get(m_baseUrl + "/games");
+        if (!isSuccess(response))
+            return response;
+
+        forFirstResult(response, { "id" }, [&](const std::vector<String>& values) {
+            id = values[0].toStdString();
+        });
+        if (!id.empty())
+            m_gameIds.set(game, id);
+        return response;
+    }
+
+    GameIdCache& m_gameIds;
+};
+
+// static
+const char* ChannelApi::defaultBaseUrl(Kind kind) {
+    switch (kind) {
+    case Kind::Kraken:
+        return "https://api.twitch.tv/kraken";
+    case Kind::Helix:
+        return "https://api.twitch.tv/helix";
+    }
+    return "";
+}
+
+// static
+bool ChannelApi::parseKind(const std::string& name, Kind& kind) {
+    if (name == "kraken")
+        kind = Kind::Kraken;
+    else if (name == "helix")
+        kind = Kind::Helix;
+    else
+        return false;
+    return true;
+}
+
+// static
+Ref<ChannelApi> ChannelApi::create(Kind kind, const std::string& baseUrl, GameIdCache& gameIds) {
+    std::string url = baseUrl.empty() ? defaultBaseUrl(kind) : baseUrl;
+    // Paths are appended with a leading slash.
+    while (url.length() && url.back() == '/')
+        url.pop_back();
+    ChannelApi* api;
+    if (kind == Kind::Helix)
+        api = new HelixApi(url, gameIds);
+    else
+        api = new KrakenApi(url);
+    return adoptRef(*api);
+}
+
+}  // namespace twitchsw
@@ -0,0 +1,79 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/channelprofile.h>
+
+#include <algorithm>
+
+namespace twitchsw {
+
+// static
+const char* const ChannelProfile::kDefaultName = "default";
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// static
+std::vector<std::string> ChannelProfile::parseNames(const std::string& names) {
+    std::vector<std::string> result;
+    const char* characters = names.c_str();
+    size_t length = names.length();
+    size_t begin = 0;
+    while (begin <= length) {
+        size_t end = begin;
+        while (end < length && characters[end] != ',')
+            ++end;
+
+        size_t first = begin;
+        size_t last = end;
+        while (first < last && isSpace(characters[first]))
+            ++first;
+        while (last > first && isSpace(characters[last - 1]))
+            --last;
+        if (first < last) {
+            std::string name(characters + first, last - first);
+            if (std::find(result.begin(), result.end(), name) == result.end())
+                result.push_back(std::move(name));
+        }
+        begin = end + 1;
+    }
+
+    if (result.empty())
+        result.push_back(kDefaultName);
+    return result;
+}
+
+void ChannelProfile::setAccessToken(const std::string& accessToken) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_accessToken == accessToken)
+        return;
+    m_accessToken = accessToken;
+    // A different token may belong to a different account.
+    m_hasLastUpdate = false;
+    m_channelName.clear();
+    m_channelId.clear();
+}
+
+void ChannelProfile::setChannel(const std::string& name, const std::string& id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_channelName = name;
+    m_channelId = id;
+}
+
+void ChannelProfile::invalidateChannel() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_channelName.clear();
+    m_channelId.clear();
+}
+
+void ChannelProfile::didUpdate(const std::string& game, const std::string& title) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hasLastUpdate = true;
+    m_lastGame = game;
+    m_lastTitle = title;
+}
+
+}  // namespace twitchsw
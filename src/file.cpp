@@ -0,0 +1,150 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/file.h>
+
+#if defined(TSW_WIN32) && TSW_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace twitchsw {
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return !file.bad();
+}
+
+static std::string temporaryPathFor(const std::string& path) {
+    return path + ".tmp";
+}
+
+bool writeFileAtomically(const std::string& path, const std::string& contents) {
+    return writeTemporaryFile(path, contents) && replaceWithTemporaryFile(path);
+}
+
+bool writeTemporaryFile(const std::string& path, const std::string& contents) {
+    std::string temporaryPath = temporaryPathFor(path);
+#if defined(TSW_WIN32) && TSW_WIN32
+    // Only used for files in the module config directory, which is under the
+    // user's profile and so not readable by other users.
+    bool result;
+    {
+        std::ofstream file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        result = !!file.write(contents.data(), contents.size());
+    }
+    if (!result)
+        DeleteFileA(temporaryPath.c_str());
+    return result;
+#else
+    int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        return false;
+    // The mode passed to open() is ignored if the file already existed.
+    bool result = fchmod(fd, S_IRUSR | S_IWUSR) == 0;
+    size_t written = 0;
+    while (result && written < contents.size()) {
+        ssize_t count = write(fd, contents.data() + written, contents.size() - written);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            result = false;
+        else
+            written += static_cast<size_t>(count);
+    }
+    result &= fsync(fd) == 0;
+    result &= close(fd) == 0;
+    if (!result)
+        unlink(temporaryPath.c_str());
+    return result;
+#endif
+}
+
+bool replaceWithTemporaryFile(const std::string& path) {
+    std::string temporaryPath = temporaryPathFor(path);
+#if defined(TSW_WIN32) && TSW_WIN32
+    if (MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        return true;
+    DeleteFileA(temporaryPath.c_str());
+    return false;
+#else
+    if (rename(temporaryPath.c_str(), path.c_str()) == 0)
+        return true;
+    unlink(temporaryPath.c_str());
+    return false;
+#endif
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#if defined(TSW_WIN32) && TSW_WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && static_cast<unsigned long long>(size.QuadPart) <= SIZE_MAX)
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The mapping keeps the file open.
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_data = static_cast<const char*>(data);
+    m_size = static_cast<size_t>(size.QuadPart);
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file open.
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    m_data = static_cast<const char*>(data);
+    m_size = static_cast<size_t>(info.st_size);
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+    if (!m_data)
+        return;
+#if defined(TSW_WIN32) && TSW_WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+}  // namespace twitchsw
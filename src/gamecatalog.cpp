@@ -0,0 +1,284 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/gamecatalog.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TSW_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace twitchsw {
+
+static const char kMagic[4] = { 'T', 'S', 'W', 'G' };
+static const uint32_t kByteOrder = 0x01020304;
+
+#if defined(TSW_HAVE_SSE2) && TSW_HAVE_SSE2
+static unsigned countTrailingZeros(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+// Returns `length` if the first `length` bytes are equal.
+static size_t firstMismatch(const char* a, const char* b, size_t length) {
+#if defined(TSW_HAVE_SSE2) && TSW_HAVE_SSE2
+    // Names are short, so most comparisons are a single vector.
+    for (size_t i = 0; i < length; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        unsigned mismatches = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) & 0xffff;
+        if (mismatches)
+            return std::min(length, i + countTrailingZeros(mismatches));
+    }
+    return length;
+#else
+    size_t i = 0;
+    while (i < length && a[i] == b[i])
+        ++i;
+    return i;
+#endif
+}
+
+// static
+int GameCatalog::comparePrefix(const char* key, size_t keyLength, const char* prefix, size_t prefixLength) {
+    size_t length = std::min(keyLength, prefixLength);
+    size_t mismatch = firstMismatch(key, prefix, length);
+    if (mismatch < length)
+        return static_cast<unsigned char>(key[mismatch]) < static_cast<unsigned char>(prefix[mismatch]) ? -1 : 1;
+    return keyLength < prefixLength ? -1 : 0;
+}
+
+static int compareText(const char* a, size_t aLength, const char* b, size_t bLength) {
+    int result = std::memcmp(a, b, std::min(aLength, bLength));
+    if (result)
+        return result;
+    return aLength < bLength ? -1 : aLength > bLength ? 1 : 0;
+}
+
+bool GameCatalog::open(const std::string& path) {
+    close();
+    if (path.empty() || !m_file.open(path))
+        return false;
+
+    const char* data = m_file.data();
+    if (m_file.size() < sizeof(Header)) {
+        m_file.close();
+        return false;
+    }
+    const Header* header = reinterpret_cast<const Header*>(data);
+    uint64_t expectedSize = sizeof(Header) +
+        static_cast<uint64_t>(header->gameCount) * (sizeof(uint64_t) + sizeof(GameRecord) + sizeof(uint32_t)) +
+        static_cast<uint64_t>(header->keyCount) * sizeof(KeyRecord) +
+        static_cast<uint64_t>(header->queryCount) * sizeof(QueryRecord) +
+        header->poolSize;
+    if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) || header->version != kVersion || header->byteOrder != kByteOrder ||
+        header->poolSize < kPoolPadding || expectedSize != m_file.size()) {
+        m_file.close();
+        return false;
+    }
+
+    m_header = header;
+    data += sizeof(Header);
+    m_popularity = reinterpret_cast<const uint64_t*>(data);
+    data += header->gameCount * sizeof(uint64_t);
+    m_games = reinterpret_cast<const GameRecord*>(data);
+    data += header->gameCount * sizeof(GameRecord);
+    m_positions = reinterpret_cast<const uint32_t*>(data);
+    data += header->gameCount * sizeof(uint32_t);
+    m_keys = reinterpret_cast<const KeyRecord*>(data);
+    data += header->keyCount * sizeof(KeyRecord);
+    m_queries = reinterpret_cast<const QueryRecord*>(data);
+    data += header->queryCount * sizeof(QueryRecord);
+    m_pool = data;
+    return true;
+}
+
+void GameCatalog::close() {
+    m_file.close();
+    m_header = nullptr;
+    m_popularity = nullptr;
+    m_games = nullptr;
+    m_positions = nullptr;
+    m_keys = nullptr;
+    m_queries = nullptr;
+    m_pool = nullptr;
+}
+
+size_t GameCatalog::gameCount() const {
+    return isOpen() ? m_header->gameCount : 0;
+}
+
+const char* GameCatalog::text(uint32_t offset, uint32_t length) const {
+    // Records are only checked when they are used, so that opening the catalog
+    // doesn't have to visit all of them.
+    if (static_cast<uint64_t>(offset) + length > m_header->poolSize - kPoolPadding)
+        return nullptr;
+    return m_pool + offset;
+}
+
+std::string GameCatalog::name(size_t game) const {
+    const GameRecord& record = m_games[game];
+    const char* name = text(record.name, record.nameLength);
+    return name ? std::string(name, record.nameLength) : std::string();
+}
+
+std::string GameCatalog::folded(size_t game) const {
+    const GameRecord& record = m_games[game];
+    const char* folded = text(record.folded, record.foldedLength);
+    return folded ? std::string(folded, record.foldedLength) : std::string();
+}
+
+uint64_t GameCatalog::popularity(size_t game) const {
+    return m_popularity[game];
+}
+
+size_t GameCatalog::position(size_t game) const {
+    return m_positions[game];
+}
+
+size_t GameCatalog::lowerBound(const char* prefix, size_t prefixLength) const {
+    size_t first = 0;
+    size_t count = m_header->keyCount;
+    while (count) {
+        size_t step = count / 2;
+        const KeyRecord& key = m_keys[first + step];
+        const char* keyText = text(key.text, key.length);
+        if (keyText && comparePrefix(keyText, key.length, prefix, prefixLength) < 0) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+bool GameCatalog::hasQuery(const std::string& foldedQuery, bool* complete) const {
+    if (!isOpen())
+        return false;
+    const QueryRecord* end = m_queries + m_header->queryCount;
+    const QueryRecord* query = std::lower_bound(m_queries, end, foldedQuery, [this](const QueryRecord& record, const std::string& query) {
+        const char* queryText = text(record.text, record.length);
+        return queryText && compareText(queryText, record.length, query.data(), query.length()) < 0;
+    });
+    if (query == end)
+        return false;
+    const char* queryText = text(query->text, query->length);
+    if (!queryText || compareText(queryText, query->length, foldedQuery.data(), foldedQuery.length()))
+        return false;
+    if (complete)
+        *complete = query->complete != 0;
+    return true;
+}
+
+void GameCatalog::read(std::vector<Game>& games, std::vector<Query>& queries) const {
+    if (!isOpen())
+        return;
+    games.reserve(games.size() + m_header->gameCount);
+    for (size_t i = 0; i < m_header->gameCount; ++i) {
+        const GameRecord& record = m_games[i];
+        const char* name = text(record.name, record.nameLength);
+        const char* folded = text(record.folded, record.foldedLength);
+        if (!name || !folded)
+            continue;
+        games.push_back(Game { std::string(name, record.nameLength), std::string(folded, record.foldedLength), m_popularity[i], m_positions[i] });
+    }
+    for (size_t i = 0; i < m_header->queryCount; ++i) {
+        const char* query = text(m_queries[i].text, m_queries[i].length);
+        if (query)
+            queries.push_back(Query { std::string(query, m_queries[i].length), m_queries[i].complete != 0 });
+    }
+}
+
+template <typename T>
+static void append(std::string& contents, const T& value) {
+    contents.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// static
+std::string GameCatalog::build(const std::vector<Game>& games, const std::vector<Query>& queries) {
+    std::string pool;
+    std::vector<GameRecord> gameRecords;
+    std::vector<KeyRecord> keys;
+    gameRecords.reserve(games.size());
+    for (size_t i = 0; i < games.size(); ++i) {
+        const Game& game = games[i];
+        GameRecord record;
+        record.name = static_cast<uint32_t>(pool.length());
+        record.nameLength = static_cast<uint32_t>(game.name.length());
+        pool += game.name;
+        record.folded = static_cast<uint32_t>(pool.length());
+        record.foldedLength = static_cast<uint32_t>(game.folded.length());
+        pool += game.folded;
+        gameRecords.push_back(record);
+
+        // A key per word, pointing into the folded name.
+        for (size_t start = 0; start < game.folded.length();) {
+            keys.push_back(KeyRecord { record.folded + static_cast<uint32_t>(start), record.foldedLength - static_cast<uint32_t>(start), static_cast<uint32_t>(i) });
+            start = game.folded.find(' ', start);
+            if (start == std::string::npos)
+                break;
+            ++start;
+        }
+    }
+    std::sort(keys.begin(), keys.end(), [&pool](const KeyRecord& a, const KeyRecord& b) {
+        return compareText(pool.data() + a.text, a.length, pool.data() + b.text, b.length) < 0;
+    });
+
+    std::vector<Query> sortedQueries = queries;
+    std::stable_sort(sortedQueries.begin(), sortedQueries.end(), [](const Query& a, const Query& b) { return a.folded < b.folded; });
+    sortedQueries.erase(std::unique(sortedQueries.begin(), sortedQueries.end(), [](const Query& a, const Query& b) {
+        return a.folded == b.folded;
+    }), sortedQueries.end());
+    std::vector<QueryRecord> queryRecords;
+    queryRecords.reserve(sortedQueries.size());
+    for (auto& query : sortedQueries) {
+        queryRecords.push_back(QueryRecord { static_cast<uint32_t>(pool.length()), static_cast<uint32_t>(query.folded.length()), query.complete ? 1u : 0u });
+        pool += query.folded;
+    }
+    pool.append(kPoolPadding, '\0');
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byteOrder = kByteOrder;
+    header.gameCount = static_cast<uint32_t>(games.size());
+    header.keyCount = static_cast<uint32_t>(keys.size());
+    header.queryCount = static_cast<uint32_t>(queryRecords.size());
+    header.poolSize = static_cast<uint32_t>(pool.length());
+    header.reserved = 0;
+
+    std::string contents;
+    contents.reserve(sizeof(Header) + games.size() * (sizeof(uint64_t) + sizeof(GameRecord) + sizeof(uint32_t)) +
+                     keys.size() * sizeof(KeyRecord) + queryRecords.size() * sizeof(QueryRecord) + pool.length());
+    append(contents, header);
+    for (auto& game : games)
+        append(contents, game.popularity);
+    for (auto& record : gameRecords)
+        append(contents, record);
+    for (auto& game : games)
+        append(contents, static_cast<uint32_t>(game.position));
+    for (auto& key : keys)
+        append(contents, key);
+    for (auto& query : queryRecords)
+        append(contents, query);
+    contents += pool;
+    return contents;
+}
+
+}  // namespace twitchsw
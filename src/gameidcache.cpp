@@ -0,0 +1,90 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/gameidcache.h>
+#include <twitchsw/file.h>
+#include <twitchsw/twitchsw.h>
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace twitchsw {
+
+bool GameIdCache::find(const std::string& game, std::string& id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    loadIfNeeded();
+    return m_cache.get(game, id);
+}
+
+void GameIdCache::set(const std::string& game, const std::string& id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    loadIfNeeded();
+    m_cache.put(game, id);
+    m_changed = true;
+}
+
+// Stored as {"games": [[name, id], ...]}, from least to most recently used.
+void GameIdCache::loadIfNeeded() {
+    if (m_loaded)
+        return;
+    m_loaded = true;
+
+    std::string contents;
+    if (m_path.empty() || !readFile(m_path, contents))
+        return;
+
+    using namespace rapidjson;
+    Document doc;
+    if (doc.Parse(contents).HasParseError() || !doc.IsObject() || !doc.HasMember("games") || !doc["games"].IsArray()) {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Ignoring unreadable game cache '%s'.", m_path.c_str());
+        return;
+    }
+    const Value& games = doc["games"];
+    for (auto it = games.Begin(); it != games.End(); ++it) {
+        if (!it->IsArray() || it->Size() != 2)
+            continue;
+        const Value& game = (*it)[SizeType(0)];
+        const Value& id = (*it)[SizeType(1)];
+        if (game.IsString() && id.IsString())
+            m_cache.put(game.GetString(), id.GetString());
+    }
+}
+
+bool GameIdCache::save() {
+    std::string contents;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_changed || m_path.empty())
+            return true;
+        m_changed = false;
+
+        using namespace rapidjson;
+        StringBuffer buffer;
+        Writer<StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("games", 5);
+        writer.StartArray();
+        m_cache.forEach([&writer](const std::string& game, const std::string& id) {
+            writer.StartArray();
+            writer.String(game.c_str(), static_cast<SizeType>(game.length()));
+            writer.String(id.c_str(), static_cast<SizeType>(id.length()));
+            writer.EndArray();
+        });
+        writer.EndArray();
+        writer.EndObject();
+        contents.assign(buffer.GetString(), buffer.GetSize());
+    }
+
+    if (!writeFileAtomically(m_path, contents)) {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Could not write game cache '%s'.", m_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace twitchsw
@@ -0,0 +1,333 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/gameindex.h>
+#include <twitchsw/file.h>
+
+#include <algorithm>
+
+namespace twitchsw {
+
+// Most popular first, then best ranked by the searches which found them.
+static bool ranksBefore(uint64_t popularity, size_t position, uint64_t otherPopularity, size_t otherPosition) {
+    if (popularity != otherPopularity)
+        return popularity > otherPopularity;
+    return position < otherPosition;
+}
+
+// Keeps the better of two rankings of the same game.
+static void mergeRank(GameCatalog::Game& game, uint64_t popularity, size_t position) {
+    game.popularity = std::max(game.popularity, popularity);
+    game.position = std::min(game.position, position);
+}
+
+static bool startsWith(const std::string& string, const std::string& prefix) {
+    return string.length() >= prefix.length() && std::equal(prefix.begin(), prefix.end(), string.begin());
+}
+
+// static
+std::string GameIndex::normalize(const std::string& name) {
+    std::string result;
+    result.reserve(name.length());
+    bool pendingSpace = false;
+    for (char c : name) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        bool isWord = byte >= 0x80 || (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z');
+        if (!isWord) {
+            pendingSpace = !result.empty();
+            continue;
+        }
+        if (pendingSpace)
+            result.push_back(' ');
+        pendingSpace = false;
+        result.push_back(byte >= 'A' && byte <= 'Z' ? static_cast<char>(byte - 'A' + 'a') : c);
+    }
+    return result;
+}
+
+static bool queryOrdersBefore(const GameCatalog::Query& query, const std::string& folded) {
+    return query.folded < folded;
+}
+
+void GameIndex::add(const std::string& query, const std::vector<GameSuggestion>& games, bool complete) {
+    std::string normalizedQuery = normalize(query);
+    if (normalizedQuery.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_games.size() + games.size() > m_capacity)
+        clearLocked();
+
+    // The latest search for a query replaces earlier ones.
+    auto searched = std::lower_bound(m_queries.begin(), m_queries.end(), normalizedQuery, queryOrdersBefore);
+    if (searched == m_queries.end() || searched->folded != normalizedQuery)
+        m_queries.insert(searched, GameCatalog::Query { normalizedQuery, complete });
+    else
+        searched->complete = complete;
+
+    std::vector<Key> keys;
+    for (size_t position = 0; position < games.size(); ++position) {
+        const GameSuggestion& suggestion = games[position];
+        auto existing = m_gameIndex.find(suggestion.name);
+        if (existing != m_gameIndex.end()) {
+            mergeRank(m_games[existing->second], suggestion.popularity, position);
+            continue;
+        }
+        std::string normalized = normalize(suggestion.name);
+        if (normalized.empty())
+            continue;
+
+        size_t index = m_games.size();
+        m_games.push_back(Game { suggestion.name, normalized, suggestion.popularity, position });
+        if (m_didBuildSimilarityIndex)
+            m_similar.add(suggestion.name, normalized);
+        m_gameIndex[suggestion.name] = index;
+        for (size_t start = 0; start != std::string::npos;) {
+            keys.push_back(Key { normalized.substr(start), index });
+            start = normalized.find(' ', start);
+            if (start != std::string::npos)
+                ++start;
+        }
+    }
+    if (keys.empty())
+        return;
+
+    // One merge per search, rather than an insertion per key.
+    auto byWord = [](const Key& a, const Key& b) { return a.word < b.word; };
+    std::sort(keys.begin(), keys.end(), byWord);
+    size_t middle = m_keys.size();
+    m_keys.insert(m_keys.end(), std::make_move_iterator(keys.begin()), std::make_move_iterator(keys.end()));
+    std::inplace_merge(m_keys.begin(), m_keys.begin() + middle, m_keys.end(), byWord);
+}
+
+bool GameIndex::hasSearched(const std::string& normalizedQuery, bool& complete) const {
+    // Searches from this session are newer than the catalog's.
+    auto searched = std::lower_bound(m_queries.begin(), m_queries.end(), normalizedQuery, queryOrdersBefore);
+    if (searched != m_queries.end() && searched->folded == normalizedQuery) {
+        complete = searched->complete;
+        return true;
+    }
+    return m_catalog.hasQuery(normalizedQuery, &complete);
+}
+
+bool GameIndex::hasSearchedPrefix(const std::string& normalizedQuery, bool& covered) const {
+    bool searched = false;
+    covered = false;
+    for (size_t length = 1; length <= normalizedQuery.length() && !covered; ++length) {
+        bool complete;
+        if (hasSearched(normalizedQuery.substr(0, length), complete)) {
+            searched = true;
+            covered = complete;
+        }
+    }
+    return searched;
+}
+
+void GameIndex::openCatalogIfNeeded() const {
+    if (m_didOpenCatalog)
+        return;
+    m_didOpenCatalog = true;
+    // A missing catalog is expected on first run, and an unusable one is
+    // replaced by the next save.
+    m_catalog.open(m_catalogPath);
+}
+
+bool GameIndex::find(const std::string& query, std::vector<std::string>& names, size_t limit) const {
+    std::string normalizedQuery = normalize(query);
+    if (normalizedQuery.empty())
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    openCatalogIfNeeded();
+    bool covered;
+    if (!hasSearchedPrefix(normalizedQuery, covered))
+        return false;
+    bool complete;
+    bool exact = hasSearched(normalizedQuery, complete);
+
+    // A game matches once per word which starts with the query.
+    std::vector<size_t> matches;
+    auto key = std::lower_bound(m_keys.begin(), m_keys.end(), normalizedQuery, [](const Key& key, const std::string& word) {
+        return key.word < word;
+    });
+    for (; key != m_keys.end() && startsWith(key->word, normalizedQuery); ++key)
+        matches.push_back(key->game);
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+
+    std::vector<size_t> catalogMatches;
+    m_catalog.forEachMatch(normalizedQuery, [&catalogMatches](size_t game) { catalogMatches.push_back(game); });
+    std::sort(catalogMatches.begin(), catalogMatches.end());
+    catalogMatches.erase(std::unique(catalogMatches.begin(), catalogMatches.end()), catalogMatches.end());
+
+    if (matches.empty() && catalogMatches.empty() && !exact)
+        return false;
+
+    // Only the best of the catalog's matches are read out of the pool. Games
+    // found this session may repeat some of them.
+    size_t catalogCount = std::min(limit, catalogMatches.size());
+    std::partial_sort(catalogMatches.begin(), catalogMatches.begin() + catalogCount, catalogMatches.end(), [this](size_t a, size_t b) {
+        if (m_catalog.popularity(a) != m_catalog.popularity(b) || m_catalog.position(a) != m_catalog.position(b))
+            return ranksBefore(m_catalog.popularity(a), m_catalog.position(a), m_catalog.popularity(b), m_catalog.position(b));
+        return a < b;
+    });
+
+    std::vector<Game> candidates;
+    candidates.reserve(matches.size() + catalogCount);
+    for (size_t game : matches)
+        candidates.push_back(m_games[game]);
+    for (size_t i = 0; i < catalogCount; ++i) {
+        size_t game = catalogMatches[i];
+        candidates.push_back(Game { m_catalog.name(game), std::string(), m_catalog.popularity(game), m_catalog.position(game) });
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Game& a, const Game& b) { return a.name < b.name; });
+    size_t unique = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (unique && candidates[unique - 1].name == candidates[i].name)
+            mergeRank(candidates[unique - 1], candidates[i].popularity, candidates[i].position);
+        else if (unique++ != i)
+            candidates[unique - 1] = std::move(candidates[i]);
+    }
+    candidates.resize(unique);
+
+    // Only a search which returned everything it matched can vouch for the
+    // games that aren't here. Otherwise, the list is only good if it's full.
+    if (!exact && !covered && candidates.size() < limit)
+        return false;
+
+    size_t count = std::min(limit, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [](const Game& a, const Game& b) {
+        if (a.popularity != b.popularity || a.position != b.position)
+            return ranksBefore(a.popularity, a.position, b.popularity, b.position);
+        return a.name < b.name;
+    });
+    for (size_t i = 0; i < count; ++i)
+        names.push_back(candidates[i].name);
+    return true;
+}
+
+void GameIndex::SimilarityIndex::add(const std::string& name, const std::string& folded) {
+    if (folded.empty() || ids.count(folded))
+        return;
+    ids[folded] = trigrams.add(folded);
+    names.push_back(name);
+}
+
+void GameIndex::buildSimilarityIndex() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_didBuildSimilarityIndex)
+            return;
+        openCatalogIfNeeded();
+    }
+
+    // Only this thread adds games or replaces the catalog, so both can be read
+    // without the lock while the index is built.
+    SimilarityIndex similar;
+    for (size_t i = 0; i < m_catalog.gameCount(); ++i)
+        similar.add(m_catalog.name(i), m_catalog.folded(i));
+    for (auto& game : m_games)
+        similar.add(game.name, game.folded);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_similar = std::move(similar);
+    m_didBuildSimilarityIndex = true;
+}
+
+bool GameIndex::resolve(const std::string& name, std::string& canonical) const {
+    std::string folded = normalize(name);
+    if (folded.empty())
+        return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto id = m_similar.ids.find(folded);
+    if (id == m_similar.ids.end())
+        return false;
+    canonical = m_similar.names[id->second];
+    return true;
+}
+
+bool GameIndex::findSimilar(const std::string& name, std::vector<std::string>& names, size_t limit) const {
+    std::string folded = normalize(name);
+    if (folded.empty())
+        return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto matches = m_similar.trigrams.search(folded, limit);
+    for (auto& match : matches)
+        names.push_back(m_similar.names[match.id]);
+    return !matches.empty();
+}
+
+size_t GameIndex::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_games.size();
+}
+
+void GameIndex::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    clearLocked();
+    m_didBuildSimilarityIndex = false;
+    m_similar = SimilarityIndex();
+}
+
+bool GameIndex::save() {
+    if (m_catalogPath.empty())
+        return true;
+
+    std::vector<Game> games;
+    std::vector<GameCatalog::Query> queries;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        openCatalogIfNeeded();
+        if (m_games.empty() && m_queries.empty())
+            return true;
+        m_catalog.read(games, queries);
+    }
+
+    // Only this thread adds games, so the ones in memory can be read without the
+    // lock while the catalog is rebuilt.
+    std::unordered_map<std::string, size_t> byName;
+    for (size_t i = 0; i < games.size(); ++i)
+        byName[games[i].name] = i;
+    for (auto& game : m_games) {
+        auto existing = byName.find(game.name);
+        if (existing == byName.end()) {
+            byName[game.name] = games.size();
+            games.push_back(game);
+        } else {
+            mergeRank(games[existing->second], game.popularity, game.position);
+        }
+    }
+    // Ahead of the catalog's, as build() keeps the first of repeated queries.
+    queries.insert(queries.begin(), m_queries.begin(), m_queries.end());
+
+    if (games.size() > kCatalogCapacity) {
+        std::partial_sort(games.begin(), games.begin() + kCatalogCapacity, games.end(), [](const Game& a, const Game& b) {
+            return ranksBefore(a.popularity, a.position, b.popularity, b.position);
+        });
+        games.resize(kCatalogCapacity);
+    }
+    std::string contents = GameCatalog::build(games, queries);
+
+    // Written and synced beside the catalog without the lock, so that searches
+    // from the main thread only wait for the rename. The catalog can't be
+    // replaced while it is mapped.
+    if (!writeTemporaryFile(m_catalogPath, contents))
+        return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_catalog.close();
+    bool result = replaceWithTemporaryFile(m_catalogPath);
+    if (m_catalog.open(m_catalogPath) && result)
+        clearLocked();
+    return result;
+}
+
+void GameIndex::clearLocked() {
+    m_games.clear();
+    m_gameIndex.clear();
+    m_keys.clear();
+    m_queries.clear();
+}
+
+}  // namespace twitchsw
@@ -0,0 +1,63 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/histogram.h>
+#include <twitchsw/compiler.h>
+
+#include <algorithm>
+
+#if TSW_COMPILER(MSVC)
+#include <intrin.h>
+#endif
+
+namespace twitchsw {
+
+// static
+unsigned Histogram::bucketForValue(uint64_t microseconds) {
+    if (!microseconds)
+        return 0;
+#if TSW_COMPILER(MSVC)
+    unsigned long index;
+    _BitScanReverse64(&index, microseconds);
+    unsigned bucket = static_cast<unsigned>(index) + 1;
+#else
+    unsigned bucket = 64 - static_cast<unsigned>(__builtin_clzll(microseconds));
+#endif
+    return std::min(bucket, kBuckets - 1);
+}
+
+void Histogram::record(Duration value) {
+    uint64_t microseconds = value.count() > 0 ? static_cast<uint64_t>(value.count()) : 0;
+    ++m_buckets[bucketForValue(microseconds)];
+    ++m_count;
+    m_sum += microseconds;
+    m_max = std::max(m_max, microseconds);
+}
+
+void Histogram::merge(const Histogram& other) {
+    for (unsigned i = 0; i < kBuckets; ++i)
+        m_buckets[i] += other.m_buckets[i];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_max = std::max(m_max, other.m_max);
+}
+
+Histogram::Duration Histogram::percentile(double p) const {
+    if (!m_count)
+        return Duration::zero();
+    p = std::max(0.0, std::min(1.0, p));
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * m_count + 0.5));
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < kBuckets; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            uint64_t upperBound = i ? (uint64_t(1) << i) - 1 : 0;
+            return Duration(std::min(upperBound, m_max));
+        }
+    }
+    return Duration(m_max);
+}
+
+}  // namespace twitchsw
@@ -4,6 +4,7 @@
 // software.
 
 #include <algorithm>
+#include <mutex>
 
 #include <curl/curl.h>
 
@@ -20,6 +21,7 @@
 
 namespace twitchsw {
 
+static std::once_flag g_initCURLOnce;
 static bool g_didInitCURL = false;
 
 class CURLRequest {
@@ -71,10 +73,18 @@ public:
 
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, static_cast<void*>(this));
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CURLRequest::receiveData);
+        if (cancelFlag) {
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, static_cast<void*>(this));
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CURLRequest::checkCancelled);
+        }
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
         if (method != "GET") {
             if (body.length()) {
                 curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+                // Sent with a Content-Length rather than chunked, which not every
+                // endpoint accepts.
+                curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(body.length()));
             }
             if (method == "PUT")
                 curl_easy_setopt(curl, CURLOPT_PUT, 1L);
@@ -106,6 +116,10 @@ public:
             }
         }
 
+        if (res == CURLE_ABORTED_BY_CALLBACK) {
+            LOG_HTTP(LOG_DEBUG, "`%s %s` cancelled", method.c_str(), reqUrl.c_str());
+            return -1;
+        }
         if (res != CURLE_OK) {
             LOG_HTTP(LOG_DEBUG, "`%s %s` (%d) failed: %s", method.c_str(), reqUrl.c_str(), status, curl_easy_strerror(res));
         } else {
@@ -139,7 +153,11 @@ public:
     void setOnRedirect(const OnRedirectCallback& callback) {
         onRedirect = callback;
     }
-    const std::string& content() const { return buffer; }
+
+    void setCancelFlag(const HttpCancelFlag& flag) {
+        cancelFlag = flag;
+    }
+    std::string takeContent() { return std::move(buffer); }
 
 private:
     static size_t receiveData(void* ptr, size_t size, size_t nmemb, void* userdata) {
@@ -148,6 +166,11 @@ private:
         return size * nmemb;
     }
 
+    static int checkCancelled(void* userdata, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        CURLRequest* req = static_cast<CURLRequest*>(userdata);
+        return req->cancelFlag->load(std::memory_order_relaxed) ? 1 : 0;
+    }
+
     static size_t sendData(char *buffer, size_t size, size_t nitems, void* userdata) {
         CURLRequest* req = static_cast<CURLRequest*>(userdata);
         size_t remaining = req->body.length() - req->cursor;
@@ -167,15 +190,16 @@ private:
     size_t cursor = 0;
     std::list<URLQueryParameter> parameters;
     OnRedirectCallback onRedirect;
+    HttpCancelFlag cancelFlag;
 };
 
 bool Http::initializeCURLIfNeeded() {
-    if (g_didInitCURL) return g_didInitCURL;
-
-    curl_global_init(CURL_GLOBAL_ALL);
-
-    g_didInitCURL = true;
-    return true;
+    // Requests may be made from several threads at once.
+    std::call_once(g_initCURLOnce, [] {
+        curl_global_init(CURL_GLOBAL_ALL);
+        g_didInitCURL = true;
+    });
+    return g_didInitCURL;
 }
 
 void Http::Shutdown() {
@@ -191,8 +215,9 @@ HttpResponse Http::GET(const std::string& url, const HttpRequestOptions& options
     request.setHeaders(options.m_headers);
     request.setParameters(options.m_parameters);
     request.setOnRedirect(options.m_onRedirect);
+    request.setCancelFlag(options.m_cancelFlag);
     int status = request.send();
-    return HttpResponse(status, request.content());
+    return HttpResponse(status, request.takeContent());
 }
 
 HttpResponse Http::PUT(const std::string& url, const std::string& body, const HttpRequestOptions& options) {
@@ -202,10 +227,25 @@ HttpResponse Http::PUT(const std::string& url, const std::string& body, const Ht
     request.setHeaders(options.m_headers);
     request.setParameters(options.m_parameters);
     request.setOnRedirect(options.m_onRedirect);
+    request.setCancelFlag(options.m_cancelFlag);
     request.setMethod("PUT");
     request.setBody(body);
     int status = request.send();
-    return HttpResponse(status, request.content());
+    return HttpResponse(status, request.takeContent());
+}
+
+HttpResponse Http::PATCH(const std::string& url, const std::string& body, const HttpRequestOptions& options) {
+    if (!initializeCURLIfNeeded()) return HttpResponse(-1);
+
+    CURLRequest request(url);
+    request.setHeaders(options.m_headers);
+    request.setParameters(options.m_parameters);
+    request.setOnRedirect(options.m_onRedirect);
+    request.setCancelFlag(options.m_cancelFlag);
+    request.setMethod("PATCH");
+    request.setBody(body);
+    int status = request.send();
+    return HttpResponse(status, request.takeContent());
 }
 
 }  // namespace twitchsw
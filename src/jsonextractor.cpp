@@ -0,0 +1,214 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/jsonextractor.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <rapidjson/reader.h>
+
+namespace twitchsw {
+
+static const size_t kNone = SIZE_MAX;
+
+static bool keyEquals(const char* expected, const char* key, rapidjson::SizeType length) {
+    return std::strlen(expected) == length && !std::memcmp(expected, key, length);
+}
+
+template <typename Entries>
+static size_t findKey(const Entries& entries, const char* key, rapidjson::SizeType length) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (keyEquals(entries[i].key, key, length))
+            return i;
+    }
+    return kNone;
+}
+
+// Tracks the nesting depth, so that members of the top-level object (depth 1) and
+// of the objects in a requested array (depth 3) can be told apart from anything
+// nested deeper. Returning false stops the reader.
+class JsonExtractor::Handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Handler> {
+public:
+    Handler(JsonExtractor& extractor, StringImpl& buffer)
+        : m_extractor(extractor)
+        , m_buffer(buffer)
+        , m_remaining(extractor.m_fields.size() + extractor.m_arrays.size())
+    {
+        for (auto& field : extractor.m_fields)
+            field.found = false;
+        for (auto& array : extractor.m_arrays)
+            array.found = false;
+    }
+
+    bool isObject() const { return m_isObject; }
+    bool isDone() const { return !m_remaining; }
+
+    bool Default() {
+        m_field = m_array = kNone;
+        return m_depth != 0;
+    }
+
+    // Parsing in place unescapes each string within the buffer.
+    bool String(const char* characters, rapidjson::SizeType length, bool) {
+        return value([&] { return StringImpl::createWithoutCopying(characters, length, m_buffer); });
+    }
+
+    bool Int(int number) { return numberValue(std::to_string(number)); }
+    bool Uint(unsigned number) { return numberValue(std::to_string(number)); }
+    bool Int64(int64_t number) { return numberValue(std::to_string(number)); }
+    bool Uint64(uint64_t number) { return numberValue(std::to_string(number)); }
+    bool Double(double number) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", number);
+        return numberValue(buffer);
+    }
+
+    bool Key(const char* key, rapidjson::SizeType length, bool) {
+        m_field = m_array = kNone;
+        if (m_depth == 1) {
+            m_field = findKey(m_extractor.m_fields, key, length);
+            if (m_field == kNone)
+                m_array = findKey(m_extractor.m_arrays, key, length);
+        } else if (m_inRow && m_depth == 3) {
+            const auto& keys = m_extractor.m_arrays[m_currentArray].keys;
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (keyEquals(keys[i], key, length)) {
+                    m_field = i;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool StartObject() {
+        if (!m_depth)
+            m_isObject = true;
+        else if (m_currentArray != kNone && m_depth == 2) {
+            m_inRow = true;
+            m_row.assign(m_extractor.m_arrays[m_currentArray].keys.size(), twitchsw::String());
+        }
+        m_field = m_array = kNone;
+        ++m_depth;
+        return !isDone();
+    }
+
+    bool EndObject(rapidjson::SizeType) {
+        --m_depth;
+        if (m_inRow && m_depth == 2) {
+            m_inRow = false;
+            auto& array = m_extractor.m_arrays[m_currentArray];
+            array.callback(m_row);
+            if (++m_rows >= array.limit)
+                return finishArray();
+        }
+        return true;
+    }
+
+    bool StartArray() {
+        if (!m_depth)
+            return false;
+        size_t array = m_array;
+        m_field = m_array = kNone;
+        ++m_depth;
+        if (array != kNone && !m_extractor.m_arrays[array].found) {
+            m_extractor.m_arrays[array].found = true;
+            m_currentArray = array;
+            m_rows = 0;
+            if (!m_extractor.m_arrays[array].limit)
+                return finishArray();
+        }
+        return true;
+    }
+
+    bool EndArray(rapidjson::SizeType) {
+        --m_depth;
+        if (m_currentArray != kNone && m_depth == 1)
+            return finishArray();
+        return true;
+    }
+
+private:
+    bool numberValue(const std::string& text) {
+        return value([&] { return twitchsw::String(text); });
+    }
+
+    // `create` is only called for values which are captured.
+    template <typename Create>
+    bool value(Create create) {
+        size_t field = m_field;
+        m_field = m_array = kNone;
+        if (!m_depth)
+            return false;
+        if (field == kNone)
+            return true;
+        if (m_inRow) {
+            m_row[field] = create();
+            return true;
+        }
+        // A repeated member keeps its first value.
+        Field& target = m_extractor.m_fields[field];
+        if (target.found)
+            return true;
+        target.found = true;
+        *target.value = create();
+        --m_remaining;
+        return !isDone();
+    }
+
+    bool finishArray() {
+        m_currentArray = kNone;
+        m_inRow = false;
+        --m_remaining;
+        return !isDone();
+    }
+
+    JsonExtractor& m_extractor;
+    StringImpl& m_buffer;
+    size_t m_remaining;
+    size_t m_depth = 0;
+    bool m_isObject = false;
+
+    // The requested member whose value comes next, if any.
+    size_t m_field = kNone;
+    size_t m_array = kNone;
+
+    // The requested array being read, and the object within it.
+    size_t m_currentArray = kNone;
+    size_t m_rows = 0;
+    bool m_inRow = false;
+    std::vector<twitchsw::String> m_row;
+};
+
+JsonExtractor& JsonExtractor::field(const char* key, String& value) {
+    m_fields.push_back(Field { key, &value, false });
+    return *this;
+}
+
+JsonExtractor& JsonExtractor::forEach(const char* arrayKey, std::vector<const char*> keys, RowCallback callback,
+                                      size_t limit) {
+    m_arrays.push_back(Array { arrayKey, std::move(keys), std::move(callback), limit, false });
+    return *this;
+}
+
+bool JsonExtractor::parse(const std::string& json) {
+    // Terminated, as the in-place reader stops at the first NUL.
+    char* data;
+    Ref<StringImpl> buffer = StringImpl::createUninitialized(data, static_cast<unsigned>(json.length() + 1));
+    std::memcpy(data, json.c_str(), json.length() + 1);
+
+    Handler handler(*this, buffer.get());
+    // In place, the reader never needs its stack.
+    rapidjson::Reader reader;
+    rapidjson::InsituStringStream stream(data);
+    rapidjson::ParseResult result = reader.Parse<rapidjson::kParseInsituFlag>(stream, handler);
+    // Stopping early surfaces as a parse error.
+    if (result.IsError() && !handler.isDone())
+        return false;
+    return handler.isObject();
+}
+
+}  // namespace twitchsw
@@ -0,0 +1,125 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/jsontemplate.h>
+
+#if defined(__AVX2__)
+#define TSW_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TSW_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace twitchsw {
+
+// What each byte becomes: 0 for itself, 'u' for \u00XX, or the character which
+// follows the backslash.
+static const char kEscapes[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+static inline char escapeFor(char c) {
+    return kEscapes[static_cast<unsigned char>(c)];
+}
+
+#if (defined(TSW_HAVE_SSE2) && TSW_HAVE_SSE2) || (defined(TSW_HAVE_AVX2) && TSW_HAVE_AVX2)
+static unsigned countTrailingZeros(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+// Returns the number of leading bytes which are copied as-is, `length` if none
+// need escaping. Titles are mostly plain text, so this is where escaping spends
+// its time: it checks 32 or 16 bytes at once, for bytes below 0x20, quotes and
+// backslashes.
+static size_t cleanPrefixLength(const char* characters, size_t length) {
+    size_t i = 0;
+#if defined(TSW_HAVE_AVX2) && TSW_HAVE_AVX2
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+    const __m256i control32 = _mm256_set1_epi8(0x1f);
+    for (; i + 32 <= length; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + i));
+        // Unsigned x <= 0x1f, as min(x, 0x1f) == x.
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(x, control32), x),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, quote32), _mm256_cmpeq_epi8(x, backslash32)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+        if (mask)
+            return i + countTrailingZeros(mask);
+    }
+#endif
+#if defined(TSW_HAVE_SSE2) && TSW_HAVE_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= length; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + i));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(x, control), x),
+            _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask)
+            return i + countTrailingZeros(mask);
+    }
+#endif
+    // The tail, shorter than a vector, or everything without SSE2.
+    while (i < length && !escapeFor(characters[i]))
+        ++i;
+    return i;
+}
+
+size_t jsonEscapedLength(const char* characters, size_t length) {
+    size_t result = length;
+    size_t i = 0;
+    while ((i += cleanPrefixLength(characters + i, length - i)) < length) {
+        result += escapeFor(characters[i]) == 'u' ? 5 : 1;
+        ++i;
+    }
+    return result;
+}
+
+char* writeJsonEscaped(char* out, const char* characters, size_t length) {
+    static const char kHexDigits[] = "0123456789ABCDEF";
+    size_t i = 0;
+    while (i < length) {
+        size_t run = cleanPrefixLength(characters + i, length - i);
+        std::memcpy(out, characters + i, run);
+        out += run;
+        i += run;
+        if (i == length)
+            break;
+
+        char c = characters[i++];
+        char escape = escapeFor(c);
+        *out++ = '\\';
+        *out++ = escape;
+        if (escape == 'u') {
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = kHexDigits[(c >> 4) & 0xF];
+            *out++ = kHexDigits[c & 0xF];
+        }
+    }
+    return out;
+}
+
+}  // namespace twitchsw
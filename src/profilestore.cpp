@@ -0,0 +1,149 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/profilestore.h>
+#include <twitchsw/file.h>
+#include <twitchsw/twitchsw.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace twitchsw {
+
+static const int kFormatVersion = 1;
+
+bool ProfileStore::find(const std::string& profile, Entry& entry) {
+    loadIfNeeded();
+    auto it = m_entries.find(profile);
+    if (it == m_entries.end())
+        return false;
+    entry = it->second;
+    return true;
+}
+
+std::vector<std::string> ProfileStore::profiles() {
+    loadIfNeeded();
+    std::vector<std::string> result;
+    result.reserve(m_entries.size());
+    for (auto& pair : m_entries)
+        result.push_back(pair.first);
+    return result;
+}
+
+void ProfileStore::set(const std::string& profile, const Entry& entry) {
+    loadIfNeeded();
+    auto it = m_entries.find(profile);
+    if (entry.accessToken.empty()) {
+        if (it == m_entries.end())
+            return;
+        m_entries.erase(it);
+    } else if (it == m_entries.end()) {
+        m_entries[profile] = entry;
+    } else if (it->second != entry) {
+        it->second = entry;
+    } else {
+        return;
+    }
+    m_changed = true;
+}
+
+void ProfileStore::loadIfNeeded() {
+    if (m_loaded)
+        return;
+    m_loaded = true;
+    if (m_path.empty())
+        return;
+
+    std::string contents;
+    if (!readFile(m_path, contents))
+        return;
+    if (!parse(contents, m_entries)) {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Ignoring unreadable profile store '%s'.", m_path.c_str());
+        m_entries.clear();
+    }
+}
+
+bool ProfileStore::save() {
+    if (!m_changed || m_path.empty())
+        return true;
+    if (!writeFileAtomically(m_path, serialize(m_entries))) {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Could not write profile store '%s': %s", m_path.c_str(), std::strerror(errno));
+        return false;
+    }
+    m_changed = false;
+    return true;
+}
+
+static std::string stringMember(const rapidjson::Value& object, const char* name) {
+    auto member = object.FindMember(name);
+    if (member == object.MemberEnd() || !member->value.IsString())
+        return std::string();
+    return std::string(member->value.GetString(), member->value.GetStringLength());
+}
+
+// static
+bool ProfileStore::parse(const std::string& json, std::map<std::string, Entry>& entries) {
+    using namespace rapidjson;
+    Document doc;
+    if (doc.Parse(json).HasParseError() || !doc.IsObject())
+        return false;
+
+    auto version = doc.FindMember("version");
+    if (version == doc.MemberEnd() || !version->value.IsInt() || version->value.GetInt() != kFormatVersion)
+        return false;
+
+    auto profiles = doc.FindMember("profiles");
+    if (profiles == doc.MemberEnd() || !profiles->value.IsObject())
+        return false;
+
+    for (auto it = profiles->value.MemberBegin(); it != profiles->value.MemberEnd(); ++it) {
+        if (!it->value.IsObject())
+            continue;
+        Entry entry;
+        entry.accessToken = stringMember(it->value, "access_token");
+        entry.channelName = stringMember(it->value, "channel_name");
+        entry.channelId = stringMember(it->value, "channel_id");
+        if (!entry.accessToken.empty())
+            entries[std::string(it->name.GetString(), it->name.GetStringLength())] = entry;
+    }
+    return true;
+}
+
+static void writeString(rapidjson::Writer<rapidjson::StringBuffer>& writer, const char* key, const std::string& value) {
+    using namespace rapidjson;
+    writer.Key(key, static_cast<SizeType>(std::strlen(key)));
+    writer.String(value.c_str(), static_cast<SizeType>(value.length()));
+}
+
+// static
+std::string ProfileStore::serialize(const std::map<std::string, Entry>& entries) {
+    using namespace rapidjson;
+    StringBuffer buffer;
+    Writer<StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("version", 7);
+    writer.Int(kFormatVersion);
+    writer.Key("profiles", 8);
+    writer.StartObject();
+    for (auto& pair : entries) {
+        writer.Key(pair.first.c_str(), static_cast<SizeType>(pair.first.length()));
+        writer.StartObject();
+        writeString(writer, "access_token", pair.second.accessToken);
+        writeString(writer, "channel_name", pair.second.channelName);
+        writeString(writer, "channel_id", pair.second.channelId);
+        writer.EndObject();
+    }
+    writer.EndObject();
+    writer.EndObject();
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+}  // namespace twitchsw
@@ -3,21 +3,10 @@
 // can be found in the LICENSE file, which must be distributed with this
 // software.
 
-#include <ctime>
-
 #include <twitchsw/twitchsw.h>
 #include <twitchsw/sceneitem.h>
-#include <twitchsw/http.h>
 #include <twitchsw/scenewatcher.h>
-#include <rapidjson/document.h>
-
-#ifdef _DEBUG
-
-#include <sstream>
-
-#include <rapidjson/reader.h>
-#include "rapidjson/prettywriter.h"
-#endif
+#include <twitchsw/workerthread.h>
 
 namespace twitchsw {
 
@@ -26,12 +15,14 @@ namespace twitchsw {
 
 enum SettingID {
     kGameSetting,
-    kTitleSetting
+    kTitleSetting,
+    kProfilesSetting
 };
 
 const TSWSceneItem::Setting<const char*> TSWSceneItem::g_stringSettings[] = {
     { offsetof(TSWSceneItem, m_game), "game", "" },
     { offsetof(TSWSceneItem, m_title), "title", "" },
+    { offsetof(TSWSceneItem, m_profiles), "profiles", "" },
 };
 
 static const char* doGetName(void* type_data) {
@@ -58,6 +49,10 @@ static obs_properties_t* doGetProperties(void* data) {
     return static_cast<TSWSceneItem*>(data)->toProperties();
 }
 
+static bool doAcceptGameCorrection(obs_properties_t* props, obs_property_t* property, void* data) {
+    return static_cast<TSWSceneItem*>(data)->acceptGameCorrection();
+}
+
 static void doUpdate(void* data, obs_data_t* settings) {
     static_cast<TSWSceneItem*>(data)->didUpdateProperties(settings);
 }
@@ -121,23 +116,32 @@ void TwitchSwitcher::initializeSceneItem() {
     obs_register_source(&g_sceneItem);
 }
 
+// The last reference to a source may be released on the WorkerThread, so items
+// can be destroyed, and looked up, off the main thread.
+static std::mutex g_sceneItemsMutex;
 static std::list<TSWSceneItem*> g_sceneItems;
 TSWSceneItem::TSWSceneItem(obs_data_t* settings, obs_source_t* source)
     : m_source(source) {
-    m_game = String();
-    m_title = String();
-    g_sceneItems.push_back(this);
+    m_game = AtomString();
+    m_title = AtomString();
+    m_profiles = AtomString();
+    {
+        std::lock_guard<std::mutex> lock(g_sceneItemsMutex);
+        g_sceneItems.push_back(this);
+    }
     connectSignalHandlers();
     LOG(LOG_INFO, "TSWSceneItem holding source %p", source);
 }
 
 TSWSceneItem::~TSWSceneItem() {
+    std::unique_lock<std::mutex> lock(g_sceneItemsMutex);
     for (auto it = g_sceneItems.begin(); it != g_sceneItems.end(); ++it) {
         if (*it == this) {
             g_sceneItems.erase(it);
             break;
         }
     }
+    lock.unlock();
     disconnectSignalHandlers();
 }
 
@@ -162,10 +166,13 @@ void TSWSceneItem::disconnectSignalHandlers() {
 void TSWSceneItem::didUpdateProperties(obs_data_t* settings) {
     for (int i = 0; i < arraysize(g_stringSettings); ++i) {
         auto setting = g_stringSettings[i];
-        String* result = reinterpret_cast<String*>((reinterpret_cast<char*>(this) + setting.offset));
-        String newValue = String(obs_data_get_string(settings, setting.name));
-        if (!newValue.equals(*result)) {
-            *result = newValue;
+        AtomString* result = reinterpret_cast<AtomString*>((reinterpret_cast<char*>(this) + setting.offset));
+        AtomString newValue(obs_data_get_string(settings, setting.name));
+        if (newValue != *result) {
+            {
+                std::lock_guard<std::mutex> lock(m_settingsMutex);
+                *result = newValue;
+            }
             if (i == kGameSetting) {
                 updateGameTitleTypeahead(settings);
             }
@@ -174,98 +181,36 @@ void TSWSceneItem::didUpdateProperties(obs_data_t* settings) {
 }
 
 void TSWSceneItem::didLoadProperties(obs_data_t* settings) {
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
     for (int i = 0; i < arraysize(g_stringSettings); ++i) {
         auto setting = g_stringSettings[i];
-        String* result = reinterpret_cast<String*>((reinterpret_cast<char*>(this) + setting.offset));
-        *result = String(obs_data_get_string(settings, setting.name));
+        AtomString* result = reinterpret_cast<AtomString*>((reinterpret_cast<char*>(this) + setting.offset));
+        *result = AtomString(obs_data_get_string(settings, setting.name));
     }
 }
 
 void TSWSceneItem::updateGameTitleTypeahead(obs_data_t* settings) {
-    // TODO(caitp): Currently, the API does not support generating typeahead-style UIs.
-    // Bug has been filed at https://obsproject.com/mantis/view.php?id=601, to revisit
-    // at a later date.
-    return;
-#pragma region TODO
-    // TODO(caitp): do this more efficiently. This will also block the entire
-    // settings dialog, which is bad.
-    static std::time_t lastTypeaheadTime = 0;
-    std::time_t now = std::time(nullptr);
-
-    if ((now - lastTypeaheadTime) < 5)
-        return;
-
-    lastTypeaheadTime = now;
-
-    String key;
-    if (!getTwitchCredentials(key))
-        return;
-
-    Http http;
-
-    auto response = http.
-        request().
-        setHeader("Authorization", "OAuth " + key.toStdString()).
-        setHeader("Client-Id", TSW_CLIENT_ID).
-        setHeader("Content-Type", "application/json").
-        setHeader("Accept", "application/vnd.twitchtv.v3+json").
-        setHeader("charsets", "utf-8").
-        setParameter("q", game().toStdString()).
-        setParameter("type", "suggest").
-        get("https://api.twitch.tv/kraken/search/games");
-
-    if (response.status() != 200) {
-        // FIXME: Use obs localization API
-        LOG(LOG_WARNING, "Bad HTTP response. Possibly rate-limited by Twitch API. Consider filing a bug at https://github.com/caitp/TwitchSwitcher");
-        return;
-    }
-    std::string content = response.content();
-
-    std::list<std::string> options;
-    {
-        using namespace rapidjson;
-
-        // Print prettified JSON string (Debug only)
-        TwitchSwitcher::prettyPrintJSON(content);
+    // The search runs on the WorkerThread, which refreshes the properties when
+    // suggestions arrive. Queries which earlier searches answer skip the network.
+    WorkerThread::suggestGames(m_source, obs_data_get_string(settings, "game"));
+}
 
-        Document doc;
-        ParseResult ok = doc.Parse(content);
-        if (!ok) {
-            // FIXME: Use obs localization API
-            LOG(LOG_WARNING, "Unexpected data from api.twitch.tv/kraken/search/games. Please file a bug at https://github.com/caitp/TwitchSwitcher");
-            return;
-        }
+void TSWSceneItem::snapshot(std::string& game, std::string& title, std::string& profiles) const {
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
+    game = m_game.toStdString();
+    title = m_title.toStdString();
+    profiles = m_profiles.toStdString();
+}
 
-        auto it = doc.FindMember("games");
-        bool expectedFormat = it != doc.MemberEnd();
-        if (expectedFormat) {
-            auto& games = it->value;
-            expectedFormat = games.IsArray();
-            if (expectedFormat) {
-                for (auto it = games.Begin(); it != games.End(); ++it) {
-                    auto& game = *it;
-                    if (!game.IsObject()) {
-                        expectedFormat = false;
-                        continue;
-                    }
-                    auto name = game.FindMember("name");
-                    if (name == game.MemberEnd()) {
-                        expectedFormat = false;
-                        continue;
-                    }
-                    if (!name->value.IsString())
-                        expectedFormat = false;
-                    else
-                        options.push_back(name->value.GetString());
-                }
-            }
-        }
-        if (!expectedFormat) {
-            // FIXME: Use obs localization API
-            LOG(LOG_WARNING, "Unexpected JSON schema from api.twitch.tv/kraken/search/games. Please file a bug at https://github.com/caitp/TwitchSwitcher");
-        }
-    }
-#pragma endregion TODO
+bool TSWSceneItem::acceptGameCorrection() {
+    if (m_gameCorrection.empty())
+        return false;
+    obs_data_t* settings = obs_source_get_settings(m_source);
+    obs_data_set_string(settings, "game", m_gameCorrection.c_str());
+    // Calls back into didUpdateProperties().
+    obs_source_update(m_source, settings);
+    obs_data_release(settings);
+    return true;
 }
 
 bool TSWSceneItem::getTwitchCredentials(String& key) const {
@@ -274,12 +219,29 @@ bool TSWSceneItem::getTwitchCredentials(String& key) const {
 
 obs_properties_t* TSWSceneItem::toProperties() {
     obs_properties_t* props = obs_properties_create();
-    obs_properties_add_list(props, "game", "Twitch Game Name", OBS_COMBO_TYPE_EDITABLE, OBS_COMBO_FORMAT_STRING);
+    obs_property_t* game = obs_properties_add_list(props, "game", "Twitch Game Name", OBS_COMBO_TYPE_EDITABLE, OBS_COMBO_FORMAT_STRING);
+    // Only games which earlier searches found. Anything else is searched for
+    // when the field is edited.
+    std::vector<std::string> names;
+    WorkerThread::findGames(m_game.toStdString(), names);
+    for (auto& name : names)
+        obs_property_list_add_string(game, name.c_str(), name.c_str());
+
+    // Offered before the game is sent, as a misspelled game is not updated.
+    std::vector<std::string> similar;
+    m_gameCorrection.clear();
+    if (WorkerThread::findSimilarGames(m_game.toStdString(), similar)) {
+        m_gameCorrection = similar.front();
+        // FIXME: Use obs localization API
+        std::string label = "Did you mean '" + m_gameCorrection + "'?";
+        obs_properties_add_button(props, "game_correction", label.c_str(), doAcceptGameCorrection);
+    }
     obs_properties_add_text(props, "title", "Twitch Channel Name", OBS_TEXT_DEFAULT);
+    // FIXME: Use obs localization API
+    obs_properties_add_text(props, "profiles", "Channel Profiles (comma separated, empty for default)", OBS_TEXT_DEFAULT);
 
-    // TODO(caitp): When typeahead support is possible, didUpdateProperties will need an update to avoid
-    // starting the typeahead on save.
-    obs_properties_set_flags(props, OBS_PROPERTIES_DEFER_UPDATE);
+    // Not deferred, so that each edit to the game field starts a typeahead query.
+    // Queries are debounced on the WorkerThread.
     return props;
 }
 
@@ -307,6 +269,7 @@ TSWSceneItem* TSWSceneItem::fromSource(obs_source_t* source) {
                 LOG(LOG_WARNING, "libobs binary compat has changed. Please file a bug at https://github.com/caitp/TwitchSwitcher.");
                 didLogBinaryCompatError = true;
             }
+            std::lock_guard<std::mutex> lock(g_sceneItemsMutex);
             for (auto item : g_sceneItems) {
                 if (item->m_source == source)
                     return item;
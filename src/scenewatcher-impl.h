@@ -7,6 +7,7 @@
 
 #include <list>
 
+#include <twitchsw/atomstring.h>
 #include <twitchsw/scenewatcher.h>
 #include <twitchsw/refs.h>
 
@@ -24,7 +25,10 @@ namespace twitchsw {
 // Held (but not retained) items are removed when signals are received from libobs,
 // preventing memory leaks.
 //
-// All SceneWatcher activity occurs on the main thread, in response to libobs signals.
+// Scene tracking occurs on the main thread, in response to libobs signals, and
+// does nothing more than post an UpdateEvent to the WorkerThread. Streaming
+// output and service lookups (which enumerate every output or service) happen
+// only on the WorkerThread, through the static SceneWatcher accessors.
 class SceneWatcherImpl;
 class Scene : public RefCounted<Scene> {
 public:
@@ -37,9 +41,12 @@ public:
     obs_source_t* source() const { return m_source; }
     obs_sceneitem_t* item() const { return m_item; }
 
+    const String& name() const { return m_name.string(); }
+
     static bool isTwitchSceneItem(obs_sceneitem_t* item);
 
-    void updateIfNeeded(bool force = false);
+    // O(1). Everything else is decided on the worker, see SceneWatcher::shouldUpdate().
+    void postUpdate(obs_output_t* startedOutput = nullptr);
 
 private:
     // SceneWatcherImpl's lifetime should always be longer than Scene instances,
@@ -48,6 +55,10 @@ private:
     obs_source_t* m_source;
     obs_sceneitem_t* m_item;
 
+    // Cached, so that posting an update does not need to copy the name which
+    // obs_source_get_name() returns. Interned, as every UpdateEvent carries it.
+    AtomString m_name;
+
     void connectSignalHandlers();
     void disconnectSignalHandlers();
     static obs_sceneitem_t* takeFirstTwitchSceneItem(obs_source_t* source, obs_sceneitem_t* ignore = nullptr);
@@ -68,6 +79,9 @@ private:
 
     // void activate(ptr source : obs_source_t)
     static void onActivate(void* userdata, calldata_t* calldata);
+
+    // void rename(ptr source : obs_source_t, string new_name, string prev_name)
+    static void onRename(void* userdata, calldata_t* calldata);
 };
 
 class SceneWatcherImpl {
@@ -78,7 +92,9 @@ public:
     void addScene(obs_source_t* scene);
     void removeScene(obs_source_t* scene);
 
+    // Worker thread only.
     bool isStreaming();
+    bool shouldUpdate(const UpdateEvent& event);
 
     void setCurrentScene(PassRefPtr<Scene> scene) {
         m_currentScene = scene;
@@ -93,6 +109,8 @@ public:
 private:
     std::list<RefPtr<Scene>> m_scenes;
     RefPtr<Scene> m_currentScene;
+
+    // Worker thread only.
     OBSWeakOutput m_streamingOutput;
     OBSWeakService m_streamingService;
 
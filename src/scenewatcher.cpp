@@ -8,12 +8,18 @@
 
 #include "scenewatcher-impl.h"
 
+#include <mutex>
+
 #include <obs-source.h>
 
 extern twitchsw::SceneWatcher g_watcher;
 
 namespace twitchsw {
 
+// Guards g_watcher.m_impl against the worker thread, which uses it through
+// the static accessors while the module is unloading.
+static std::mutex g_watcherMutex;
+
 SceneWatcher::SceneWatcher() {
 
 }
@@ -24,20 +30,35 @@ SceneWatcher::~SceneWatcher() {
 
 void SceneWatcher::start() {
     if (m_impl != nullptr) return;
-    m_impl = new SceneWatcherImpl();
+    SceneWatcherImpl* impl = new SceneWatcherImpl();
+    std::lock_guard<std::mutex> lock(g_watcherMutex);
+    m_impl = impl;
 }
 
 void SceneWatcher::terminate() {
-    if (m_impl == nullptr) return;
-    delete m_impl;
-    m_impl = nullptr;
+    SceneWatcherImpl* impl;
+    {
+        std::lock_guard<std::mutex> lock(g_watcherMutex);
+        impl = m_impl;
+        m_impl = nullptr;
+    }
+    delete impl;
 }
 
+// static
 bool SceneWatcher::getTwitchCredentials(String& key) {
+    std::lock_guard<std::mutex> lock(g_watcherMutex);
     if (g_watcher.m_impl == nullptr) return false;
     return g_watcher.m_impl->getTwitchCredentials(key);
 }
 
+// static
+bool SceneWatcher::shouldUpdate(const UpdateEvent& event) {
+    std::lock_guard<std::mutex> lock(g_watcherMutex);
+    if (g_watcher.m_impl == nullptr) return false;
+    return g_watcher.m_impl->shouldUpdate(event);
+}
+
 //
 //
 //
@@ -184,30 +205,33 @@ void SceneWatcherImpl::removeSourceIfNeeded(void* userdata, calldata_t* calldata
 
 
 // Called in response to `start` of obs_output_t. We use this to update the twitch status and game on stream start,
-// if needed
+// if needed. Whether `output` is still the Twitch stream is checked on the worker, in shouldUpdate().
 void SceneWatcherImpl::onStartStreaming(void* userdata, calldata_t* calldata) {
     SceneWatcherImpl* impl = static_cast<SceneWatcherImpl*>(userdata);
     obs_output_t* output;
     if (!calldata_get_ptr(calldata, "output", &output))
         return;
 
-    do {
-        if (impl->m_streamingOutput == nullptr)
-            break;
+    if (impl->m_currentScene)
+        impl->m_currentScene->postUpdate(output);
+}
 
-        OBSOutput currentOutput = OBSGetStrongRef(impl->m_streamingOutput);
-        if (currentOutput != output) {
-            impl->m_streamingOutput = nullptr;
-            break;
-        }
+bool SceneWatcherImpl::shouldUpdate(const UpdateEvent& event) {
+    obs_output_t* output = event.startedOutput();
+    if (output == nullptr)
+        return TwitchSwitcher::isEnabled(TwitchSwitcher::kUpdateWithoutStreaming) || isStreaming();
 
-        if (impl->m_currentScene)
-            impl->m_currentScene->updateIfNeeded(true);
-        return;
-    } while (0);
+    if (m_streamingOutput != nullptr) {
+        OBSOutput currentOutput = OBSGetStrongRef(m_streamingOutput);
+        if (currentOutput == output)
+            return true;
+        m_streamingOutput = nullptr;
+    }
 
+    // No longer the streaming output, stop listening to it.
     signal_handler_t* signals = obs_output_get_signal_handler(output);
-    signal_handler_disconnect(signals, "start", onStartStreaming, impl);
+    signal_handler_disconnect(signals, "start", onStartStreaming, this);
+    return false;
 }
 
 
@@ -268,7 +292,7 @@ RefPtr<Scene> SceneWatcherImpl::findScene(obs_source_t* source) {
 //
 
 Scene::Scene(SceneWatcherImpl* impl, obs_source_t* scene)
-    : RefCounted(), m_impl(impl), m_source(scene), m_item(nullptr) {
+    : RefCounted(), m_impl(impl), m_source(scene), m_item(nullptr), m_name(obs_source_get_name(scene)) {
     connectSignalHandlers();
     if (!m_item)
         m_item = takeFirstTwitchSceneItem(m_source);
@@ -289,6 +313,7 @@ void Scene::connectSignalHandlers() {
     signal_handler_connect(signals, "item_remove", onRemoveSceneItem, this);
     signal_handler_connect(signals, "show", onShow, this);
     signal_handler_connect(signals, "activate", onActivate, this);
+    signal_handler_connect(signals, "rename", onRename, this);
 }
 
 void Scene::disconnectSignalHandlers() {
@@ -299,6 +324,7 @@ void Scene::disconnectSignalHandlers() {
     signal_handler_disconnect(signals, "item_remove", onRemoveSceneItem, this);
     signal_handler_disconnect(signals, "show", onShow, this);
     signal_handler_disconnect(signals, "activate", onActivate, this);
+    signal_handler_disconnect(signals, "rename", onRename, this);
 }
 
 void Scene::onAddSceneItem(void* userdata, calldata_t* calldata) {
@@ -327,24 +353,27 @@ void Scene::onShow(void* userdata, calldata_t* calldata) {
     RefPtr<Scene> scene = static_cast<Scene*>(userdata);
     SceneWatcherImpl* impl = scene->m_impl;
     impl->setCurrentScene(scene);
-    scene->updateIfNeeded();
+    scene->postUpdate();
 }
 
 void Scene::onActivate(void* userdata, calldata_t* calldata) {
 }
 
-void Scene::updateIfNeeded(bool force) {
-    TSWSceneItem* item = TSWSceneItem::fromSceneItem(m_item);
-    if (item == nullptr) return;
+void Scene::onRename(void* userdata, calldata_t* calldata) {
+    RefPtr<Scene> scene = static_cast<Scene*>(userdata);
+    AtomString name(calldata_string(calldata, "new_name"));
+    if (name != scene->m_name)
+        scene->m_name = name;
+}
 
-    if (!force && TwitchSwitcher::isDisabled(TwitchSwitcher::kUpdateWithoutStreaming) && !this->m_impl->isStreaming())
-        return;
+void Scene::postUpdate(obs_output_t* startedOutput) {
+    // m_item is only ever set to a TwitchSwitcher item.
+    if (m_item == nullptr) return;
 
-    String scene = obs_source_get_name(m_source);
-    String game = item->game();
-    String title = item->title();
+    obs_source_t* item = obs_sceneitem_get_source(m_item);
     // FIXME: Use obs localization API
-    WorkerThread::update(*new UpdateEvent(scene, game, title));
+    if (!WorkerThread::update(adoptRef(*new UpdateEvent(m_name.string(), item, startedOutput))))
+        LOG(LOG_DEBUG, "Worker queue is full, discarded update for scene '%s'", m_name.characters());
 }
 
 //
@@ -4,8 +4,16 @@
 // software.
 
 #include <twitchsw/string.h>
+#include <twitchsw/atomstring.h>
 #include <twitchsw/never-destroyed.h>
 
+#include <cassert>
+#include <cstring>
+
+#if TSW_COMPILER(MSVC) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
 namespace twitchsw {
 
 StringImpl* StringImpl::empty()
@@ -17,8 +25,16 @@ StringImpl* StringImpl::empty()
 // static
 void StringImpl::destroy(StringImpl* stringImpl)
 {
+    if (stringImpl->m_isAtom)
+        AtomString::remove(*stringImpl);
+
+    StringImpl* owner = nullptr;
+    if (stringImpl->m_bufferOwnership == BufferSubstring)
+        owner = *stringImpl->tailPointer<StringImpl*>();
     stringImpl->~StringImpl();
     fastDealloc(stringImpl);
+    if (owner)
+        owner->deref();
 }
 
 // static
@@ -45,7 +61,19 @@ Ref<StringImpl> StringImpl::createWithoutCopying(const char* characters, unsigne
 {
     if (!length)
         return *empty();
-    return adoptRef(*new StringImpl(characters, length, ConstructWithoutCopying));
+    // Allocated like every other StringImpl, as destroy() frees with fastDealloc().
+    void* memory = fastAllocUninitialized(sizeof(StringImpl));
+    return adoptRef(*new (memory) StringImpl(characters, length, ConstructWithoutCopying));
+}
+
+// static
+Ref<StringImpl> StringImpl::createWithoutCopying(const char* characters, unsigned length, StringImpl& owner)
+{
+    assert(characters >= owner.characters() && characters + length <= owner.characters() + owner.length());
+    if (!length)
+        return *empty();
+    void* memory = fastAllocUninitialized(allocationSize<StringImpl*>(1));
+    return adoptRef(*new (memory) StringImpl(characters, length, owner, ConstructSubstring));
 }
 
 // static
@@ -104,4 +132,92 @@ bool StringImpl::equals(const char* characters, unsigned length) const
     return ::strncmp(m_data, characters, length) == 0;
 }
 
+// Hashing follows wyhash (https://github.com/wangyi-fudan/wyhash): each step
+// multiplies two 64-bit words into 128 bits and folds the halves together.
+// Strings longer than 48 bytes are consumed in three independent lanes of 16
+// bytes, so that the multiplies overlap.
+static const uint64_t kHashSecret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull
+};
+
+static inline uint64_t multiplyMix(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif TSW_COMPILER(MSVC) && defined(_M_X64)
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    uint64_t aHigh = a >> 32, aLow = static_cast<uint32_t>(a);
+    uint64_t bHigh = b >> 32, bLow = static_cast<uint32_t>(b);
+    uint64_t highHigh = aHigh * bHigh, highLow = aHigh * bLow, lowHigh = aLow * bHigh, lowLow = aLow * bLow;
+    uint64_t middle = (lowLow >> 32) + static_cast<uint32_t>(highLow) + static_cast<uint32_t>(lowHigh);
+    uint64_t low = (middle << 32) | static_cast<uint32_t>(lowLow);
+    uint64_t high = highHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+    return low ^ high;
+#endif
+}
+
+static inline uint64_t read64(const char* p)
+{
+    uint64_t value;
+    ::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t read32(const char* p)
+{
+    uint32_t value;
+    ::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// static
+unsigned StringImpl::computeHash(const char* characters, unsigned length)
+{
+    const char* p = characters;
+    uint64_t seed = multiplyMix(kHashSecret[0], kHashSecret[1]);
+    uint64_t a, b;
+    if (length <= 16) {
+        if (length >= 4) {
+            unsigned shift = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + shift);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - shift);
+        } else if (length) {
+            a = (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16) |
+                (static_cast<uint64_t>(static_cast<unsigned char>(p[length >> 1])) << 8) |
+                static_cast<unsigned char>(p[length - 1]);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        unsigned remaining = length;
+        if (remaining > 48) {
+            uint64_t lane1 = seed, lane2 = seed;
+            do {
+                seed = multiplyMix(read64(p) ^ kHashSecret[1], read64(p + 8) ^ seed);
+                lane1 = multiplyMix(read64(p + 16) ^ kHashSecret[2], read64(p + 24) ^ lane1);
+                lane2 = multiplyMix(read64(p + 32) ^ kHashSecret[3], read64(p + 40) ^ lane2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (remaining > 16) {
+            seed = multiplyMix(read64(p) ^ kHashSecret[1], read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+    uint64_t hash = multiplyMix(kHashSecret[1] ^ length, multiplyMix(a ^ kHashSecret[1], b ^ seed));
+    unsigned result = static_cast<unsigned>(hash ^ (hash >> 32));
+    // 0 means "not computed yet".
+    return result ? result : 1;
+}
+
 }  // namespace twitchsw
@@ -8,8 +8,11 @@
 #include <twitchsw/twitchsw.h>
 #include <twitchsw/refs.h>
 
+#include <atomic>
+
 namespace twitchsw {
 
+class AtomString;
 template <typename T> class NeverDestroyed;
 
 class StringImpl {
@@ -23,6 +26,9 @@ public:
 
     static Ref<StringImpl> create(const char* characters, unsigned length);
     static Ref<StringImpl> createWithoutCopying(const char* characters, unsigned length);
+    // Shares `characters`, which must lie within `owner`, and keeps `owner` alive
+    // for as long as the new string is.
+    static Ref<StringImpl> createWithoutCopying(const char* characters, unsigned length, StringImpl& owner);
     static Ref<StringImpl> createUninitialized(char*& data, unsigned length);
 
     static void destroy(StringImpl*);
@@ -34,31 +40,60 @@ private:
 
     Ref<StringImpl> initializeFromUTF8(unsigned length)
     {
-        m_refCount = kRefCountIncrement;
+        m_refCount.store(kRefCountIncrement, std::memory_order_relaxed);
         m_length = length;
         m_data = tailPointer<char>();
+        m_bufferOwnership = BufferInternal;
+        m_isAtom = false;
+        m_hash.store(0, std::memory_order_relaxed);
         return adoptRef(*this);
     }
 
+    enum BufferOwnership : unsigned char {
+        // Characters follow the StringImpl in the same allocation.
+        BufferInternal,
+        // Characters are owned by someone else, and outlive the StringImpl.
+        BufferExternal,
+        // Characters lie within another StringImpl, which the tail refers to.
+        BufferSubstring,
+    };
+
     enum ConstructWithoutCopyingTag { ConstructWithoutCopying };
     StringImpl(const char* characters, unsigned length, ConstructWithoutCopyingTag)
         : m_refCount(kRefCountIncrement)
         , m_length(length)
         , m_data(characters)
-        , m_unused(0)
+        , m_bufferOwnership(BufferExternal)
+        , m_isAtom(false)
+        , m_hash(0)
     {
     }
 
+    enum ConstructSubstringTag { ConstructSubstring };
+    StringImpl(const char* characters, unsigned length, StringImpl& owner, ConstructSubstringTag)
+        : m_refCount(kRefCountIncrement)
+        , m_length(length)
+        , m_data(characters)
+        , m_bufferOwnership(BufferSubstring)
+        , m_isAtom(false)
+        , m_hash(0)
+    {
+        owner.ref();
+        *tailPointer<StringImpl*>() = &owner;
+    }
+
     // Used to construct static strings, which have an special refCount that can never hit zero.
-    // This means that the static string will never be destroyed, which is important because
-    // static strings will be shared across threads & ref-counted in a non-threadsafe manner.
+    // This means that the static string will never be destroyed, and as it is shared by every
+    // thread, ref() and deref() leave its count alone rather than contend on it.
     friend class NeverDestroyed<StringImpl>;
     enum ConstructEmptyStringTag { ConstructEmptyString };
     StringImpl(ConstructEmptyStringTag)
         : m_refCount(kStaticStringFlag)
         , m_length(0)
         , m_data(reinterpret_cast<const char*>(&m_length))
-        , m_unused(0)
+        , m_bufferOwnership(BufferExternal)
+        , m_isAtom(false)
+        , m_hash(0)
     {
     }
 
@@ -79,45 +114,88 @@ public:
     bool endsWith(const char* characters, unsigned length) const;
     bool equals(const char* characters, unsigned length) const;
 
+    // Computed on first use, and cached. Never 0.
+    unsigned hash() const
+    {
+        unsigned hash = m_hash.load(std::memory_order_relaxed);
+        if (LIKELY(hash))
+            return hash;
+        hash = computeHash(m_data, m_length);
+        m_hash.store(hash, std::memory_order_relaxed);
+        return hash;
+    }
+
+    // 0 if hash() was never called.
+    unsigned existingHash() const { return m_hash.load(std::memory_order_relaxed); }
+
+    // The hash of any string with these characters, for looking one up without
+    // creating it.
+    static unsigned computeHash(const char* characters, unsigned length);
+
     char at(unsigned i) const
     {
         return m_data[i];
     }
     char operator[](unsigned i) const { return at(i); }
 
-    inline bool isStatic() const { return m_refCount & kStaticStringFlag; }
+    // The flag is set at construction and never changes, so it can be read
+    // without ordering.
+    inline bool isStatic() const { return m_refCount.load(std::memory_order_relaxed) & kStaticStringFlag; }
+
+    // Set once, by the AtomString table, before the string is shared.
+    inline bool isAtom() const { return m_isAtom; }
 
     inline size_t refCount() const
     {
-        return m_refCount >> 1;
+        return m_refCount.load(std::memory_order_relaxed) >> 1;
     }
 
     inline bool hasOneRef() const
     {
-        return m_refCount == kRefCountIncrement;
+        return m_refCount.load(std::memory_order_acquire) == kRefCountIncrement;
     }
 
     inline bool hasAtLeastOneRef() const
     {
-        return !!m_refCount;
+        return !!m_refCount.load(std::memory_order_relaxed);
     }
 
+    // Strings are handed between the OBS thread and the worker (UpdateEvent,
+    // TSWSceneItem::game()), so the count is atomic. Taking a reference needs
+    // no ordering; releasing the last one must see every other thread's
+    // releases before destroying the string.
     inline void ref()
     {
-        m_refCount += kRefCountIncrement;
+        if (isStatic())
+            return;
+        m_refCount.fetch_add(kRefCountIncrement, std::memory_order_relaxed);
     }
 
     inline void deref()
     {
-        unsigned tempRefCount = m_refCount - kRefCountIncrement;
-        if (!tempRefCount)
-            return StringImpl::destroy(this);
-        m_refCount = tempRefCount;
+        if (isStatic())
+            return;
+        if (m_refCount.fetch_sub(kRefCountIncrement, std::memory_order_acq_rel) == kRefCountIncrement)
+            StringImpl::destroy(this);
     }
 
     static StringImpl* empty();
 
 private:
+    friend class AtomString;
+
+    // Takes a reference unless the last one is already gone, which the
+    // AtomString table can observe while the string is being destroyed.
+    inline bool tryRef()
+    {
+        unsigned refCount = m_refCount.load(std::memory_order_relaxed);
+        while (refCount >= kRefCountIncrement) {
+            if (m_refCount.compare_exchange_weak(refCount, refCount + kRefCountIncrement, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
     template<typename T>
     static size_t allocationSize(unsigned tailElementCount)
     {
@@ -131,7 +209,7 @@ private:
         // MSVC doesn't support alignof yet.
         return roundUpToMultipleOf<sizeof(T)>(sizeof(StringImpl));
 #else
-        return roundUpToMultipleOf<alignof(T)>(offsetof(StringImpl, m_unused) + sizeof(StringImpl::m_unused));
+        return roundUpToMultipleOf<alignof(T)>(offsetof(StringImpl, m_hash) + sizeof(StringImpl::m_hash));
 #endif
     }
 
@@ -148,10 +226,14 @@ private:
     }
 
 private:
-    unsigned m_refCount;
+    std::atomic<unsigned> m_refCount;
     unsigned m_length;
     const char* m_data;
-    mutable unsigned m_unused;
+    BufferOwnership m_bufferOwnership;
+    bool m_isAtom;
+    // 0 until hash() is first called. Any thread may compute it, and they all
+    // store the same value.
+    mutable std::atomic<unsigned> m_hash;
 };
 
 }  // namespace twitchsw
@@ -0,0 +1,140 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/threadscheduling.h>
+#include <twitchsw/compiler.h>
+
+#if defined(TSW_WIN32) && TSW_WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <pthread/qos.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+namespace twitchsw {
+
+#if defined(TSW_WIN32) && TSW_WIN32
+
+bool applyCurrentThreadScheduling(const ThreadScheduling& scheduling) {
+    bool result = true;
+    HANDLE thread = GetCurrentThread();
+    switch (scheduling.policy) {
+    case ThreadScheduling::Policy::Default:
+        break;
+    case ThreadScheduling::Policy::Batch:
+        result &= !!SetThreadPriority(thread, THREAD_PRIORITY_BELOW_NORMAL);
+        break;
+    case ThreadScheduling::Policy::Idle:
+        result &= !!SetThreadPriority(thread, THREAD_PRIORITY_LOWEST);
+        break;
+    }
+    if (scheduling.affinityMask)
+        result &= SetThreadAffinityMask(thread, static_cast<DWORD_PTR>(scheduling.affinityMask)) != 0;
+    return result;
+}
+
+void setCurrentThreadName(const char* name) {
+    // SetThreadDescription() is not available on every supported Windows
+    // version, and the exception-based naming protocol only works with a
+    // debugger attached.
+    UNUSED(name);
+}
+
+#elif defined(__APPLE__)
+
+bool applyCurrentThreadScheduling(const ThreadScheduling& scheduling) {
+    bool result = true;
+    switch (scheduling.policy) {
+    case ThreadScheduling::Policy::Default:
+        break;
+    case ThreadScheduling::Policy::Batch:
+        result &= !pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+        break;
+    case ThreadScheduling::Policy::Idle:
+        result &= !pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+        break;
+    }
+    // setpriority() applies to the whole process on Mac, so niceLevel is
+    // ignored, and there is no hard CPU affinity to speak of.
+    if (scheduling.affinityMask)
+        result = false;
+    return result;
+}
+
+void setCurrentThreadName(const char* name) {
+    pthread_setname_np(name);
+}
+
+#else
+
+bool applyCurrentThreadScheduling(const ThreadScheduling& scheduling) {
+    bool result = true;
+    int policy = -1;
+    switch (scheduling.policy) {
+    case ThreadScheduling::Policy::Default:
+        break;
+    case ThreadScheduling::Policy::Batch:
+        policy = SCHED_BATCH;
+        break;
+    case ThreadScheduling::Policy::Idle:
+        policy = SCHED_IDLE;
+        break;
+    }
+    if (policy != -1) {
+        sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        result &= !pthread_setschedparam(pthread_self(), policy, &param);
+    }
+
+    // Linux threads each have their own nice value, addressed by thread ID.
+    if (scheduling.niceLevel) {
+        id_t tid = static_cast<id_t>(syscall(SYS_gettid));
+        result &= !setpriority(PRIO_PROCESS, tid, scheduling.niceLevel);
+    }
+
+    if (scheduling.affinityMask) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (unsigned cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu) {
+            if (scheduling.affinityMask & (uint64_t(1) << cpu))
+                CPU_SET(cpu, &cpus);
+        }
+        result &= !pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    return result;
+}
+
+void setCurrentThreadName(const char* name) {
+    // The kernel limits names to 16 bytes, including the terminator, and
+    // rejects longer ones outright.
+    char truncated[16];
+    std::strncpy(truncated, name, sizeof(truncated) - 1);
+    truncated[sizeof(truncated) - 1] = '\0';
+    pthread_setname_np(pthread_self(), truncated);
+}
+
+#endif
+
+const char* threadSchedulingPolicyName(ThreadScheduling::Policy policy) {
+    switch (policy) {
+    case ThreadScheduling::Policy::Default:
+        return "default";
+    case ThreadScheduling::Policy::Batch:
+        return "batch";
+    case ThreadScheduling::Policy::Idle:
+        return "idle";
+    }
+    return "unknown";
+}
+
+}  // namespace twitchsw
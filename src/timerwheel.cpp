@@ -0,0 +1,223 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/timerwheel.h>
+
+#include <algorithm>
+#include <cassert>
+
+#if TSW_COMPILER(MSVC)
+#include <intrin.h>
+#endif
+
+namespace twitchsw {
+
+static ALWAYS_INLINE unsigned countTrailingZeros(uint64_t value)
+{
+    // Undefined for zero, on either compiler.
+    assert(value != 0);
+#if TSW_COMPILER(MSVC)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+}
+
+static ALWAYS_INLINE uint64_t rotateRight(uint64_t value, unsigned amount)
+{
+    amount &= 63;
+    if (!amount)
+        return value;
+    return (value >> amount) | (value << (64 - amount));
+}
+
+TimerWheel::TimerWheel(Duration tick, TimePoint epoch)
+    : m_tick(std::max(tick, Duration(1)))
+    , m_epoch(epoch)
+{
+}
+
+TimerWheel::~TimerWheel() {
+    for (unsigned level = 0; level < kLevels; ++level) {
+        for (unsigned slot = 0; slot < kSlotsPerLevel; ++slot) {
+            Timer* timer = m_slots[level][slot];
+            while (timer) {
+                Timer* next = timer->m_next;
+                timer->m_prev = timer->m_next = nullptr;
+                timer->m_wheel = nullptr;
+                timer->deref();
+                timer = next;
+            }
+        }
+    }
+}
+
+uint64_t TimerWheel::tickFloor(TimePoint time) const {
+    if (time <= m_epoch)
+        return 0;
+    return static_cast<uint64_t>((time - m_epoch) / m_tick);
+}
+
+uint64_t TimerWheel::tickCeil(TimePoint time) const {
+    if (time <= m_epoch)
+        return 0;
+    Duration elapsed = time - m_epoch;
+    return static_cast<uint64_t>((elapsed + m_tick - Duration(1)) / m_tick);
+}
+
+Ref<TimerWheel::Timer> TimerWheel::schedule(TimePoint deadline, Callback callback, Duration period) {
+    Ref<Timer> timer = adoptRef(*new Timer(std::move(callback), period));
+    // Never fire early: round the deadline up to the next tick, and never expire
+    // in the tick which is currently being (or has already been) processed.
+    timer->m_expiration = std::max(tickCeil(deadline), m_current + 1);
+    timer->m_wheel = this;
+    timer->ref();
+    link(timer.ptr());
+    ++m_count;
+    return timer;
+}
+
+bool TimerWheel::cancel(Timer& timer) {
+    if (timer.m_cancelled)
+        return false;
+    timer.m_cancelled = true;
+    if (timer.m_wheel == this) {
+        unlink(&timer);
+        timer.m_wheel = nullptr;
+        --m_count;
+        timer.deref();
+    }
+    return true;
+}
+
+// Inserts the timer into the slot matching its expiration. Timers which expire
+// beyond the range of the wheel are parked in the top level, and re-linked when
+// that slot is cascaded.
+void TimerWheel::link(Timer* timer) {
+    unsigned level = 0;
+    uint64_t position = m_current;
+    if (timer->m_expiration > m_current) {
+        static const uint64_t kMaxDelta = (uint64_t(1) << (kLevels * kLevelBits)) - 1;
+        uint64_t delta = std::min(timer->m_expiration - m_current, kMaxDelta);
+        while (level + 1 < kLevels && delta >= (uint64_t(1) << ((level + 1) * kLevelBits)))
+            ++level;
+        position = (m_current + delta) >> (level * kLevelBits);
+    }
+
+    unsigned slot = static_cast<unsigned>(position & kSlotMask);
+    Timer*& head = m_slots[level][slot];
+    timer->m_level = static_cast<uint8_t>(level);
+    timer->m_slot = static_cast<uint8_t>(slot);
+    timer->m_prev = nullptr;
+    timer->m_next = head;
+    if (head)
+        head->m_prev = timer;
+    head = timer;
+    m_occupied[level] |= uint64_t(1) << slot;
+}
+
+void TimerWheel::unlink(Timer* timer) {
+    if (timer->m_prev) {
+        timer->m_prev->m_next = timer->m_next;
+    } else {
+        Timer*& head = m_slots[timer->m_level][timer->m_slot];
+        head = timer->m_next;
+        if (!head)
+            m_occupied[timer->m_level] &= ~(uint64_t(1) << timer->m_slot);
+    }
+    if (timer->m_next)
+        timer->m_next->m_prev = timer->m_prev;
+    timer->m_prev = timer->m_next = nullptr;
+}
+
+// Called whenever m_current reaches a new tick. Moves timers out of every upper
+// level slot whose range begins at this tick, starting from the top.
+void TimerWheel::cascade() {
+    unsigned levels = 1;
+    while (levels < kLevels && !(m_current & ((uint64_t(1) << (levels * kLevelBits)) - 1)))
+        ++levels;
+
+    for (unsigned level = levels - 1; level > 0; --level) {
+        unsigned slot = static_cast<unsigned>((m_current >> (level * kLevelBits)) & kSlotMask);
+        Timer* timer = m_slots[level][slot];
+        m_slots[level][slot] = nullptr;
+        m_occupied[level] &= ~(uint64_t(1) << slot);
+        while (timer) {
+            Timer* next = timer->m_next;
+            link(timer);
+            timer = next;
+        }
+    }
+}
+
+size_t TimerWheel::fireSlot(unsigned slot) {
+    size_t fired = 0;
+    while (Timer* timer = m_slots[0][slot]) {
+        Ref<Timer> protect(*timer);
+        unlink(timer);
+        timer->m_wheel = nullptr;
+        --m_count;
+        timer->deref();
+
+        ++fired;
+        timer->m_callback();
+
+        if (timer->isRepeating() && !timer->m_cancelled && !timer->isScheduled()) {
+            uint64_t period = std::max<uint64_t>(1, static_cast<uint64_t>((timer->m_period + m_tick - Duration(1)) / m_tick));
+            timer->m_expiration = std::max(timer->m_expiration + period, m_current + 1);
+            timer->m_wheel = this;
+            timer->ref();
+            link(timer);
+            ++m_count;
+        }
+    }
+    return fired;
+}
+
+// Returns the earliest tick at which either a timer in level 0 expires, or an
+// occupied upper level slot must be cascaded.
+uint64_t TimerWheel::nextTick() const {
+    uint64_t result = ~uint64_t(0);
+    for (unsigned level = 0; level < kLevels; ++level) {
+        uint64_t occupied = m_occupied[level];
+        if (!occupied)
+            continue;
+        unsigned shift = level * kLevelBits;
+        uint64_t position = m_current >> shift;
+        unsigned index = static_cast<unsigned>(position & kSlotMask);
+        unsigned distance = countTrailingZeros(rotateRight(occupied, index + 1)) + 1;
+        result = std::min(result, (position + distance) << shift);
+    }
+    return result;
+}
+
+size_t TimerWheel::advance(TimePoint now) {
+    uint64_t target = tickFloor(now);
+    size_t fired = 0;
+    while (m_current < target) {
+        // Skip directly to the next tick with work to do. Slots which are passed
+        // over are known to be empty.
+        uint64_t next = m_count ? nextTick() : target + 1;
+        if (next > target) {
+            m_current = target;
+            break;
+        }
+        m_current = next;
+        cascade();
+        fired += fireSlot(static_cast<unsigned>(m_current & kSlotMask));
+    }
+    return fired;
+}
+
+bool TimerWheel::nextDeadline(TimePoint& deadline) const {
+    if (!m_count)
+        return false;
+    deadline = m_epoch + m_tick * static_cast<Duration::rep>(nextTick());
+    return true;
+}
+
+}  // namespace twitchsw
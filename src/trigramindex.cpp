@@ -0,0 +1,119 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <twitchsw/trigramindex.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace twitchsw {
+
+constexpr double TrigramIndex::kDefaultThreshold;
+
+// static
+void TrigramIndex::trigrams(const std::string& text, std::vector<uint32_t>& result) {
+    result.clear();
+    if (text.empty())
+        return;
+    std::string padded = " " + text + " ";
+    result.reserve(padded.length() - 2);
+    for (size_t i = 0; i + 3 <= padded.length(); ++i) {
+        result.push_back(static_cast<uint32_t>(static_cast<unsigned char>(padded[i])) << 16 |
+                         static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 1])) << 8 |
+                         static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 2])));
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+size_t TrigramIndex::add(const std::string& text) {
+    uint32_t id = static_cast<uint32_t>(m_trigramCounts.size());
+    std::vector<uint32_t> keys;
+    trigrams(text, keys);
+    // Ids only grow, so every posting list stays sorted.
+    for (uint32_t key : keys)
+        m_postings[key].push_back(id);
+    m_trigramCounts.push_back(static_cast<uint16_t>(std::min<size_t>(keys.size(), std::numeric_limits<uint16_t>::max())));
+    m_hits.push_back(0);
+    return id;
+}
+
+void TrigramIndex::clear() {
+    m_postings.clear();
+    m_trigramCounts.clear();
+    m_hits.clear();
+}
+
+std::vector<TrigramIndex::Match> TrigramIndex::search(const std::string& query, size_t limit, double threshold) {
+    std::vector<Match> matches;
+    trigrams(query, m_queryTrigrams);
+    if (m_queryTrigrams.empty() || !limit)
+        return matches;
+    // Keeps hit counts within a byte.
+    if (m_queryTrigrams.size() > std::numeric_limits<uint8_t>::max())
+        m_queryTrigrams.resize(std::numeric_limits<uint8_t>::max());
+
+    // A string scores at least `threshold` only if it shares `required`
+    // trigrams with the query, so it must be in one of the query's
+    // `query - required + 1` shortest lists. Only those lists are walked; the
+    // longer ones, for trigrams like "the", are only probed for the strings
+    // which the short ones found.
+    std::vector<const std::vector<uint32_t>*> lists;
+    lists.reserve(m_queryTrigrams.size());
+    for (uint32_t key : m_queryTrigrams) {
+        auto posting = m_postings.find(key);
+        if (posting != m_postings.end())
+            lists.push_back(&posting->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+        return a->size() < b->size();
+    });
+    double queryCount = static_cast<double>(m_queryTrigrams.size());
+    size_t required = std::max<size_t>(1, static_cast<size_t>(std::ceil(threshold * queryCount / (2.0 - threshold) - 1e-9)));
+    size_t walked = required <= m_queryTrigrams.size() ? m_queryTrigrams.size() - required + 1 : 0;
+
+    m_touched.clear();
+    for (size_t i = 0; i < lists.size() && i < walked; ++i) {
+        for (uint32_t id : *lists[i]) {
+            if (!m_hits[id]++)
+                m_touched.push_back(id);
+        }
+    }
+    for (size_t i = walked; i < lists.size(); ++i) {
+        const std::vector<uint32_t>& list = *lists[i];
+        // Probing costs a binary search per candidate. When there are too many
+        // candidates for that to pay off, the list is walked instead.
+        if (m_touched.size() * static_cast<size_t>(std::log2(list.size() + 1) + 1) < list.size()) {
+            for (uint32_t id : m_touched) {
+                if (std::binary_search(list.begin(), list.end(), id))
+                    ++m_hits[id];
+            }
+        } else {
+            for (uint32_t id : list) {
+                if (m_hits[id])
+                    ++m_hits[id];
+            }
+        }
+    }
+
+    for (uint32_t id : m_touched) {
+        double score = 2.0 * m_hits[id] / (queryCount + m_trigramCounts[id]);
+        m_hits[id] = 0;
+        if (score >= threshold)
+            matches.push_back(Match { id, score });
+    }
+
+    size_t count = std::min(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), [](const Match& a, const Match& b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.id < b.id;
+    });
+    matches.resize(count);
+    return matches;
+}
+
+}  // namespace twitchsw
@@ -3,11 +3,13 @@
 // can be found in the LICENSE file, which must be distributed with this
 // software.
 
+#include <algorithm>
 #include <thread>
 #include <mutex>
 
 #include <obs.hpp>
 #include <obs-module.h>
+#include <util/platform.h>
 
 #include <twitchsw/scenewatcher.h>
 #include <twitchsw/workerthread.h>
@@ -36,6 +38,111 @@ static bool hasStreamingOutput(std::string& id) {
     return found;
 }
 
+// TSW_WORKER_QUEUE_CAPACITY=<n, at most 64>
+// TSW_WORKER_QUEUE_POLICY=coalesce|drop-oldest-update|reject
+// TSW_WORKER_METRICS_INTERVAL=<seconds, 0 to disable>
+static WorkerThread::QueueOptions workerQueueOptions() {
+    WorkerThread::QueueOptions options;
+    if (auto capacity = std::getenv("TSW_WORKER_QUEUE_CAPACITY")) {
+        long value = std::strtol(capacity, nullptr, 10);
+        if (value > 0)
+            options.capacity = static_cast<size_t>(value);
+    }
+    if (auto policy = std::getenv("TSW_WORKER_QUEUE_POLICY")) {
+        std::string name(policy);
+        if (name == "coalesce")
+            options.policy = WorkerThread::OverflowPolicy::Coalesce;
+        else if (name == "drop-oldest-update")
+            options.policy = WorkerThread::OverflowPolicy::DropOldestUpdate;
+        else if (name == "reject")
+            options.policy = WorkerThread::OverflowPolicy::Reject;
+        else
+            LOG(LOG_WARNING, "Unknown TSW_WORKER_QUEUE_POLICY '%s', using 'coalesce'.", policy);
+    }
+    if (auto interval = std::getenv("TSW_WORKER_METRICS_INTERVAL")) {
+        long value = std::strtol(interval, nullptr, 10);
+        if (value >= 0)
+            options.metricsLogInterval = std::chrono::seconds(value);
+    }
+    return options;
+}
+
+// TSW_WORKER_SCHED=default|batch|idle
+// TSW_WORKER_NICE=<-20..19>
+// TSW_WORKER_AFFINITY=<cpu mask, e.g. 0xc0>
+//
+// By default the worker runs as a batch thread with a raised nice level, so that
+// it only gets CPU time the OBS encoder and render threads are not using.
+static ThreadScheduling workerScheduling() {
+    ThreadScheduling scheduling;
+    scheduling.policy = ThreadScheduling::Policy::Batch;
+    scheduling.niceLevel = 10;
+    if (auto policy = std::getenv("TSW_WORKER_SCHED")) {
+        std::string name(policy);
+        if (name == "default")
+            scheduling.policy = ThreadScheduling::Policy::Default;
+        else if (name == "batch")
+            scheduling.policy = ThreadScheduling::Policy::Batch;
+        else if (name == "idle")
+            scheduling.policy = ThreadScheduling::Policy::Idle;
+        else
+            LOG(LOG_WARNING, "Unknown TSW_WORKER_SCHED '%s', using 'batch'.", policy);
+    }
+    if (auto nice = std::getenv("TSW_WORKER_NICE")) {
+        long value = std::strtol(nice, nullptr, 10);
+        scheduling.niceLevel = static_cast<int>(std::max(-20L, std::min(19L, value)));
+    }
+    if (auto affinity = std::getenv("TSW_WORKER_AFFINITY"))
+        scheduling.affinityMask = std::strtoull(affinity, nullptr, 0);
+    return scheduling;
+}
+
+// Returns the path of `file` in the module's config directory, which is created
+// if needed.
+static std::string configFilePath(const char* file) {
+    if (char* directory = obs_module_config_path("")) {
+        os_mkdirs(directory);
+        bfree(directory);
+    }
+    char* path = obs_module_config_path(file);
+    if (!path)
+        return std::string();
+    std::string result(path);
+    bfree(path);
+    return result;
+}
+
+// TSW_TOKEN_VALIDATION_URL=<url>
+// TSW_TOKEN_VALIDATION_INTERVAL=<seconds, 0 to disable>
+// TSW_TOKEN_REFRESH_MARGIN=<seconds>
+// TSW_API=kraken|helix
+// TSW_API_BASE_URL=<url, e.g. http://localhost:8080>
+static WorkerThread::AuthOptions workerAuthOptions() {
+    WorkerThread::AuthOptions options;
+    options.profileStorePath = configFilePath("profiles.json");
+    options.gameCachePath = configFilePath("games.json");
+    options.gameCatalogPath = configFilePath("games.catalog");
+    if (auto api = std::getenv("TSW_API")) {
+        if (!ChannelApi::parseKind(api, options.api))
+            LOG(LOG_WARNING, "Unknown TSW_API '%s', using 'kraken'.", api);
+    }
+    if (auto url = std::getenv("TSW_API_BASE_URL"))
+        options.apiBaseUrl = url;
+    if (auto url = std::getenv("TSW_TOKEN_VALIDATION_URL"))
+        options.validationUrl = url;
+    if (auto interval = std::getenv("TSW_TOKEN_VALIDATION_INTERVAL")) {
+        long value = std::strtol(interval, nullptr, 10);
+        if (value >= 0)
+            options.validationInterval = std::chrono::seconds(value);
+    }
+    if (auto margin = std::getenv("TSW_TOKEN_REFRESH_MARGIN")) {
+        long value = std::strtol(margin, nullptr, 10);
+        if (value >= 0)
+            options.refreshMargin = std::chrono::seconds(value);
+    }
+    return options;
+}
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("twitchsw", "en-US")
 OBS_MODULE_AUTHOR("Caitlin Potter")
@@ -66,7 +173,7 @@ MODULE_EXPORT bool obs_module_load(void) {
     LOG(LOG_INFO, "Started up");
     TwitchSwitcher::initializeSceneItem();
     WebView::initialize();
-    g_worker.start();
+    g_worker.start(workerQueueOptions(), workerScheduling(), workerAuthOptions());
     g_watcher.start();
     return true;
 }
@@ -74,6 +181,11 @@ MODULE_EXPORT bool obs_module_load(void) {
 MODULE_EXPORT void obs_module_unload(void) {
     WebView::shutdown();
     g_watcher.terminate();
+
+    auto stats = WorkerThread::queueStats();
+    LOG(LOG_INFO, "Worker queue: capacity %zu, high water mark %zu, %llu coalesced, %llu dropped, %llu rejected",
+        stats.capacity, stats.highWaterMark, static_cast<unsigned long long>(stats.coalesced),
+        static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.rejected));
     g_worker.terminate();
 }
 
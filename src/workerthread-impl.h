@@ -6,12 +6,22 @@
 #pragma once
 
 #include <twitchsw/workerthread.h>
+#include <twitchsw/channelprofile.h>
+#include <twitchsw/future.h>
+#include <twitchsw/profilestore.h>
+#include <twitchsw/gameidcache.h>
+#include <twitchsw/gameindex.h>
 #include <twitchsw/webview.h>
+#include <twitchsw/timerwheel.h>
+#include <twitchsw/ringbuffer.h>
 
-#include <list>
+#include <cassert>
 #include <mutex>
 #include <thread>
 #include <future>
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace twitchsw {
 
@@ -22,13 +32,64 @@ struct MessageData {
     {
     }
 
-    MessageData(WorkerThread::Message messageID, PassRefPtr<EventData> data = nullptr)
+    MessageData(WorkerThread::Message messageID, RefPtr<EventData>&& data)
         : message(messageID)
-        , param(data)
+        , param(std::move(data))
+        , enqueuedAt(TimerWheel::Clock::now())
     {
     }
     WorkerThread::Message message;
     RefPtr<EventData> param = nullptr;
+    TimerWheel::TimePoint enqueuedAt;
+};
+
+// What an UpdateEvent resolves to on the worker, once its scene item's settings
+// have been read.
+struct SceneUpdate {
+    std::string game;
+    std::string title;
+    std::string profiles;
+};
+
+// Payload of a kTask message.
+class TaskEvent : public EventData {
+public:
+    explicit TaskEvent(std::function<void()>&& task)
+        : m_task(std::move(task))
+    {
+    }
+
+    void run() { m_task(); }
+
+private:
+    std::function<void()> m_task;
+};
+
+// A game typeahead query for a scene item. Holds a reference to the item's
+// source until the request is destroyed.
+class TypeaheadRequest : public EventData {
+public:
+    TypeaheadRequest(obs_source* item, const std::string& query);
+    ~TypeaheadRequest() override;
+
+    obs_source* item() const { return m_item; }
+    const std::string& query() const { return m_query; }
+
+private:
+    obs_source* m_item;
+    std::string m_query;
+};
+
+class WorkerThreadImpl;
+
+// Runs future continuations on the worker thread, between messages.
+class WorkerExecutor : public Executor {
+public:
+    explicit WorkerExecutor(WorkerThreadImpl& worker) : m_worker(worker) {}
+    void post(std::function<void()>&& task) override;
+
+private:
+    WorkerThreadImpl& m_worker;
 };
 
 struct AuthStatus {
@@ -38,83 +99,265 @@ struct AuthStatus {
 
 class WorkerThreadImpl {
 public:
+    WorkerThreadImpl(const WorkerThread::QueueOptions& options, const ThreadScheduling& scheduling,
+                     const WorkerThread::AuthOptions& auth);
     ~WorkerThreadImpl();
 
     void start();
 
-    void postMessage(WorkerThread::Message message, PassRefPtr<EventData> data = nullptr) {
-        if (m_thread == nullptr) return;
-
-        bool wasEmpty;
-        {
-            std::lock_guard<std::mutex> lock(m_messageListMutex);
-            wasEmpty = m_messageList.empty();
-            MessageData event(message, data);
-            if (message <= WorkerThread::kLastPriviledgedMessage)
-                m_messageList.push_front(event);
-            else
-                m_messageList.push_back(event);
-        }
-        if (wasEmpty)
-            m_didReceiveMessage.notify_one();
+    // Returns false if the message was discarded because the queue is full.
+    bool postMessage(WorkerThread::Message message, RefPtr<EventData>&& data = nullptr);
+
+    WorkerThread::QueueStats queueStats() {
+        std::lock_guard<std::mutex> lock(m_messageListMutex);
+        WorkerThread::QueueStats stats = m_queueStats;
+        stats.depth = m_messageList.size();
+        return stats;
     }
 
+    WorkerThread::Metrics metrics();
+
+    // Continuations posted here run on the worker thread. Tasks posted after
+    // the worker has terminated are discarded.
+    Executor& executor() { return m_executor; }
+
 private:
     friend class WorkerThread;
+
+    // Extra room in the message queue for priviledged messages, which ignore
+    // the configured capacity.
+    static const size_t kPriviledgedMessageReserve = 4;
+
     std::thread* m_thread = nullptr;
     std::condition_variable m_didReceiveMessage;
     std::mutex m_messageListMutex;
-    std::list<MessageData> m_messageList;
-    std::string m_accessToken;
+    RingBuffer<MessageData> m_messageList;
+
+    // Only accessed from the worker thread. Swapped with m_messageList to drain
+    // every pending message at once, so it is reserved to the same capacity.
+    RingBuffer<MessageData> m_batch;
+    WorkerThread::QueueOptions m_queueOptions;
+    WorkerThread::QueueStats m_queueStats;
+    ThreadScheduling m_scheduling;
+    WorkerThread::AuthOptions m_authOptions;
+    WorkerExecutor m_executor;
+
+    // Guarded by m_messageListMutex.
+    WorkerThread::MessageMetrics m_messageMetrics[WorkerThread::kMessageCount];
+
+    // Only accessed from the worker thread.
+    bool m_didAbsorbUpdate = false;
+    uint64_t m_messagesHandledAtLastLog = 0;
+    std::map<std::string, RefPtr<ChannelProfile>> m_profiles;
+    ProfileStore m_profileStore;
+    GameIdCache m_gameIds;
+    RefPtr<ChannelApi> m_api;
+
+    // Read from the main thread as well, through WorkerThread::findGames().
+    GameIndex m_gameIndex;
+    RefPtr<TimerWheel::Timer> m_gameCatalogSave;
+
+    // Normalized games which a search couldn't find, and when. Scene switches
+    // repeat the same game, which isn't searched for again until the entry
+    // expires, or the catalog is saved with games which may resolve it.
+    std::map<std::string, TimerWheel::TimePoint> m_unknownGames;
+    Future<AuthStatus> m_signIn;
+    RefPtr<ChannelProfile> m_signInProfile;
     WeakPtr<WebView> m_currentWebView;
 
+    // The outcome of a game search. Failed searches aren't recorded, so that the
+    // next keystroke, or the next update, asks again.
+    struct GameSearch {
+        std::vector<GameSuggestion> games;
+        bool succeeded = false;
+        bool complete = false;
+    };
+
+    // The latest typeahead query for each item, while it is debounced or being
+    // searched.
+    struct PendingTypeahead {
+        RefPtr<TypeaheadRequest> request;
+        RefPtr<TimerWheel::Timer> timer;
+        Future<void> search;
+    };
+    std::map<obs_source*, PendingTypeahead> m_typeaheads;
+
+    // Searches run off the worker, so that a slow search never holds up an
+    // update. Finished threads are reaped when the next search starts.
+    std::vector<std::future<void>> m_typeaheadThreads;
+
+    // An update which is waiting for a profile to sign in, or for its requests
+    // to finish. The worker keeps handling messages meanwhile, and `step`'s
+    // continuation resumes the update.
+    struct PendingUpdate {
+        // The most recent event, whose data is sent once sign-in is complete.
+        RefPtr<UpdateEvent> data;
+        // Keeps the resolved event alive, so that a replacement can't reuse its
+        // slot.
+        RefPtr<UpdateEvent> resolved;
+        SceneUpdate update;
+        TimerWheel::TimePoint enqueuedAt;
+        bool didAbsorb = false;
+        TimerWheel::TimePoint absorbedEnqueuedAt;
+
+        std::vector<std::string> names;
+        size_t nextProfile = 0;
+        std::vector<Ref<ChannelProfile>> profiles;
+
+        // Set once the requests are made. An update which arrives after that is
+        // sent when this one is done, as if it had waited in the queue.
+        bool isSending = false;
+        RefPtr<UpdateEvent> next;
+        TimerWheel::TimePoint nextEnqueuedAt;
+
+        Future<void> step;
+    };
+    std::unique_ptr<PendingUpdate> m_pendingUpdate;
+
+    // Threads making an update's requests: its game search, and its request to
+    // each profile. Finished threads are reaped when the next one starts.
+    std::vector<std::future<void>> m_updateThreads;
+
+    TimerWheel m_timers;
+
     void run();
 
     static void runImpl(WorkerThreadImpl* worker);
 
-    bool waitForMessage(MessageData& data) {
-        std::unique_lock<std::mutex> lock(m_messageListMutex);
-        while (m_messageList.empty())
-            m_didReceiveMessage.wait(lock);
-        MessageData copy = m_messageList.front();
-        data = { copy.message, copy.param.leakRef() };
-        m_messageList.pop_front();
-        return true;
-    }
-
-    // Blocks for the allotted time, returns true if a message has become available.
-    template <typename Rep, typename Period>
-    bool waitForMessageAvailable(const std::chrono::duration<Rep, Period>& timeout_duration) {
+    // Blocks until at least one message is received, or until the next timer is
+    // due, then moves every pending message into `batch` in a single critical
+    // section. Updates which are superseded by a later update in the same batch
+    // are marked kNoMessage. Returns false if no message was received.
+    bool waitForMessages(RingBuffer<MessageData>& batch) {
+        // Swapped with the queue, which must be left empty.
+        assert(batch.empty());
         std::unique_lock<std::mutex> lock(m_messageListMutex);
-        if (!m_messageList.empty() &&
-            m_didReceiveMessage.wait_for(lock, timeout_duration) == std::cv_status::no_timeout)
-            return true;
-        return false;
-    }
+        while (m_messageList.empty()) {
+            TimerWheel::TimePoint deadline;
+            if (!m_timers.nextDeadline(deadline)) {
+                m_didReceiveMessage.wait(lock);
+            } else if (m_didReceiveMessage.wait_until(lock, deadline) == std::cv_status::timeout) {
+                if (m_messageList.empty())
+                    return false;
+            }
+        }
+        batch.swap(m_messageList);
 
-    // Blocks for the allotted time, and reutrns message if found
-    template <typename Rep, typename Period>
-    bool waitForMessage(MessageData& data, const std::chrono::duration<Rep, Period>& timeout_duration) {
-        std::unique_lock<std::mutex> lock(m_messageListMutex);
-        if (!m_messageList.empty() ||
-            m_didReceiveMessage.wait_for(lock, timeout_duration) == std::cv_status::no_timeout) {
-            // FIXME(caitp): For some reason MSVC reaches this point with an empty messageList. Am I abusing the message list CV?
-            if (!m_messageList.empty()) {
-                MessageData copy = m_messageList.front();
-                data = { copy.message, copy.param.leakRef() };
-                m_messageList.pop_front();
-                return true;
+        TimerWheel::TimePoint now = TimerWheel::Clock::now();
+        bool sawUpdate = false;
+        for (size_t i = batch.size(); i--;) {
+            MessageData& data = batch[i];
+            m_messageMetrics[data.message].queueWait.record(now - data.enqueuedAt);
+            if (data.message == WorkerThread::kUpdate) {
+                if (sawUpdate) {
+                    // The event is released outside of the lock, with the batch.
+                    data.message = WorkerThread::kNoMessage;
+                    ++m_queueStats.coalesced;
+                }
+                sawUpdate = true;
             }
         }
-        return false;
+        return true;
     }
 
     // If returned false, WorkerThreadImpl is dead and you should exit.
     bool handleMessage(MessageData& data);
+    bool handleBatch(RingBuffer<MessageData>& batch);
+    bool dispatchMessage(MessageData& data);
+
+    // Writes metrics to the log, if any messages were handled since the last call.
+    void logMetricsIfChanged();
+
+    // Timers run on the worker thread, between messages. These must only be
+    // called from the worker thread.
+    Ref<TimerWheel::Timer> scheduleTimer(TimerWheel::Duration delay, TimerWheel::Callback callback) {
+        return m_timers.scheduleAfter(delay, std::move(callback));
+    }
+    Ref<TimerWheel::Timer> scheduleRepeatingTimer(TimerWheel::Duration period, TimerWheel::Callback callback) {
+        return m_timers.scheduleRepeating(period, std::move(callback));
+    }
+    void cancelTimer(TimerWheel::Timer& timer) { m_timers.cancel(timer); }
+    void fireExpiredTimers() { m_timers.advance(TimerWheel::Clock::now()); }
+
+    // Profiles are created on first use, with any credentials saved by a previous
+    // session.
+    Ref<ChannelProfile> profile(const std::string& name);
+
+    // Writes every profile's credentials to the profile store, if they changed.
+    void saveProfiles();
+
+    Future<AuthStatus> authenticateIfNeeded(ChannelProfile& profile);
+
+    // Opens the sign-in window for `profile`, even if it already has a token. The
+    // current token is used until the new one arrives.
+    Future<AuthStatus> signIn(ChannelProfile& profile);
+    bool isSigningIn() const { return m_signIn.isValid() && !m_signIn.isReady(); }
+
+    enum class TokenStatus {
+        Valid,
+        Invalid,
+        Unknown
+    };
+
+    // Checks the profile's token against the validation endpoint. `expiresIn` is
+    // zero if the token does not expire.
+    static TokenStatus validateToken(const ChannelProfile& profile, const std::string& url, std::chrono::seconds& expiresIn);
+
+    // Runs on a timer. Replaces tokens which were revoked or are about to expire,
+    // so that updates during a show don't have to sign in.
+    void validateProfiles();
+
+    // Returns false if the update should be dropped.
+    bool resolveUpdate(const UpdateEvent& data, SceneUpdate& update);
+    void update(Ref<UpdateEvent> data, TimerWheel::TimePoint enqueuedAt);
+
+    // Sign-in is interactive, so profiles without a token are authenticated one
+    // at a time, each resuming the update when it is done.
+    void authenticateProfiles();
+    void didAuthenticate(const Future<AuthStatus>& status);
+    void sendUpdate();
+    void didSearchGame(const std::string& game, const GameSearch& search);
+    void startSending();
+    void finishUpdate();
+    void recordUpdateLatency(TimerWheel::TimePoint enqueuedAt);
+
+    // Replaces `game` with the API's spelling of it, if the index knows it. A
+    // game which a recent search couldn't find is cleared, so that only the title
+    // is updated rather than setting a misspelled game. Returns false if the API
+    // should be asked about it instead, which resumes the update from
+    // didSearchGame().
+    bool resolveGame(std::string& game);
+    // Warns that `game` is unknown, naming a similar one if there is one, and
+    // clears it.
+    void dropUnknownGame(std::string& game);
+    static const std::chrono::minutes kUnknownGameTimeout;
+
+    // Sends the update to every profile at once, each on its own thread, so the
+    // worker never waits on a request. The returned future is ready when the
+    // slowest has finished.
+    Future<void> fanOutUpdate(std::vector<Ref<ChannelProfile>>& profiles, const std::string& game, const std::string& title);
+
+    // Returns the profile's cached channel, or looks it up and caches it.
+    static bool lookUpChannel(ChannelApi& api, ChannelProfile& profile, std::string& channel, std::string& channelId);
+
+    // Called from the fan-out threads.
+    static void updateChannel(ChannelApi& api, ChannelProfile& profile, const std::string& game, const std::string& title);
+
+    // Typing in the game field sends a query per keystroke, so each one waits
+    // this long for the next before searching.
+    static const std::chrono::milliseconds kTypeaheadDebounce;
+
+    // New games are written to the catalog in batches, at most this often.
+    static const std::chrono::seconds kGameCatalogSaveDelay;
+    void saveGameCatalog();
 
-    std::future<AuthStatus> authenticateIfNeeded();
-    bool update(Ref<UpdateEvent> data);
-    bool updateInternal(const std::string& accessToken, String game, String title);
+    void suggestGames(Ref<TypeaheadRequest> request);
+    void startTypeahead(obs_source* item);
+    // Searches on a thread, which is added to `threads`.
+    Future<GameSearch> startGameSearch(const std::string& accessToken, const std::string& query,
+                                       std::vector<std::future<void>>& threads);
+    void finishTypeahead(const TypeaheadRequest& request, const GameSearch& search);
+    void cancelTypeaheads();
     void cleanup();
 };
 
@@ -4,14 +4,20 @@
 // software.
 
 #include <twitchsw/scenewatcher.h>
+#include <twitchsw/sceneitem.h>
 #include <twitchsw/http.h>
+#include <twitchsw/jsonextractor.h>
 #include <twitchsw/webview.h>
 
+#include <twitchsw/never-destroyed.h>
+#include <twitchsw/slotpool.h>
+
 #include "workerthread-impl.h"
 
 #include <obs.h>
 
-#include <rapidjson/document.h>
+#include <cstdlib>
+
 #include <rapidjson/writer.h>
 
 namespace twitchsw {
@@ -20,9 +26,9 @@ WorkerThreadImpl* WorkerThread::m_impl = nullptr;
 WorkerThread::WorkerThread() {}
 WorkerThread::~WorkerThread() { terminate(); }
 
-void WorkerThread::start() {
+void WorkerThread::start(const QueueOptions& options, const ThreadScheduling& scheduling, const AuthOptions& auth) {
     if (m_impl) return;
-    m_impl = new WorkerThreadImpl;
+    m_impl = new WorkerThreadImpl(options, scheduling, auth);
     m_impl->start();
 }
 
@@ -34,15 +40,142 @@ void WorkerThread::terminate() {
     m_impl = nullptr;
 }
 
-void WorkerThread::update(Ref<UpdateEvent> event) {
+bool WorkerThread::update(Ref<UpdateEvent> event) {
+    if (!m_impl || !m_impl->m_thread) return false;
+    return m_impl->postMessage(WorkerThread::kUpdate, std::move(event));
+}
+
+// static
+void WorkerThread::suggestGames(obs_source* item, const std::string& query) {
     if (!m_impl || !m_impl->m_thread) return;
-    m_impl->postMessage(WorkerThread::kUpdate, event.ptr());
+    WorkerThreadImpl* impl = m_impl;
+    RefPtr<TypeaheadRequest> request = adoptRef(new TypeaheadRequest(item, query));
+    impl->executor().post([impl, request] {
+        impl->suggestGames(*request);
+    });
+}
+
+// static
+bool WorkerThread::findGames(const std::string& query, std::vector<std::string>& names) {
+    if (!m_impl) return false;
+    return m_impl->m_gameIndex.find(query, names);
+}
+
+// static
+bool WorkerThread::findSimilarGames(const std::string& game, std::vector<std::string>& names) {
+    if (!m_impl) return false;
+    std::string canonical;
+    if (m_impl->m_gameIndex.resolve(game, canonical))
+        return false;
+    return m_impl->m_gameIndex.findSimilar(game, names);
+}
+
+// Enough slots for the largest queue of updates, and a batch of as many taken
+// from it, plus the pending update's three (its data, the one it resolved, and
+// the one waiting behind it) and the one being posted.
+typedef SlotPool<sizeof(UpdateEvent), 2 * WorkerThread::QueueOptions::kMaxCapacity + 4> UpdateEventPool;
+
+static UpdateEventPool& updateEventPool() {
+    // Never destroyed, as events may outlive static destructors during shutdown.
+    static NeverDestroyed<UpdateEventPool> pool;
+    return pool;
+}
+
+UpdateEvent::UpdateEvent(const String& scene, obs_source_t* item, obs_output_t* startedOutput)
+    : m_scene(scene)
+    , m_item(item)
+    , m_startedOutput(startedOutput)
+{
+    if (m_item)
+        obs_source_addref(m_item);
+    if (m_startedOutput)
+        obs_output_addref(m_startedOutput);
+}
+
+UpdateEvent::~UpdateEvent() {
+    if (m_item)
+        obs_source_release(m_item);
+    if (m_startedOutput)
+        obs_output_release(m_startedOutput);
+}
+
+void* UpdateEvent::operator new(size_t size) {
+    return updateEventPool().allocate(size);
+}
+
+void UpdateEvent::operator delete(void* ptr) {
+    updateEventPool().deallocate(ptr);
+}
+
+TypeaheadRequest::TypeaheadRequest(obs_source_t* item, const std::string& query)
+    : m_item(item)
+    , m_query(query)
+{
+    obs_source_addref(m_item);
+}
+
+TypeaheadRequest::~TypeaheadRequest() {
+    obs_source_release(m_item);
+}
+
+WorkerThread::QueueStats WorkerThread::queueStats() {
+    if (!m_impl) return QueueStats();
+    return m_impl->queueStats();
+}
+
+WorkerThread::Metrics WorkerThread::metrics() {
+    if (!m_impl) return Metrics();
+    return m_impl->metrics();
+}
+
+// static
+const char* WorkerThread::messageName(Message message) {
+    switch (message) {
+    case kNoMessage:
+        return "none";
+    case kTerminate:
+        return "terminate";
+    case kUpdate:
+        return "update";
+    case kTask:
+        return "task";
+    }
+    return "unknown";
+}
+
+//
+//
+//
+
+void WorkerExecutor::post(std::function<void()>&& task) {
+    // If the worker has stopped, the task is destroyed here, which breaks any
+    // promise it holds.
+    m_worker.postMessage(WorkerThread::kTask, adoptRef(new TaskEvent(std::move(task))));
 }
 
 //
 //
 //
 
+WorkerThreadImpl::WorkerThreadImpl(const WorkerThread::QueueOptions& options, const ThreadScheduling& scheduling,
+                                   const WorkerThread::AuthOptions& auth)
+    : m_queueOptions(options)
+    , m_scheduling(scheduling)
+    , m_authOptions(auth)
+    , m_executor(*this)
+    , m_profileStore(auth.profileStorePath)
+    , m_gameIds(auth.gameCachePath)
+    , m_api(ChannelApi::create(auth.api, auth.apiBaseUrl, m_gameIds).ptr())
+    , m_gameIndex(auth.gameCatalogPath) {
+    if (!m_queueOptions.capacity)
+        m_queueOptions.capacity = 1;
+    if (m_queueOptions.capacity > WorkerThread::QueueOptions::kMaxCapacity)
+        m_queueOptions.capacity = WorkerThread::QueueOptions::kMaxCapacity;
+    m_queueStats.capacity = m_queueOptions.capacity;
+    m_messageList.reserve(m_queueOptions.capacity + kPriviledgedMessageReserve);
+    m_batch.reserve(m_queueOptions.capacity + kPriviledgedMessageReserve);
+}
+
 WorkerThreadImpl::~WorkerThreadImpl() {
     if (m_thread != nullptr) {
         delete m_thread;
@@ -55,34 +188,177 @@ void WorkerThreadImpl::start() {
     m_thread = new std::thread(runImpl, this);
 }
 
+bool WorkerThreadImpl::postMessage(WorkerThread::Message message, RefPtr<EventData>&& data) {
+    if (m_thread == nullptr) return false;
+
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(m_messageListMutex);
+        wasEmpty = m_messageList.empty();
+        if (message <= WorkerThread::kLastPriviledgedMessage) {
+            // Priviledged messages are never discarded, and do not count against
+            // the capacity.
+            m_messageList.pushFront(MessageData(message, std::move(data)));
+        } else {
+            size_t pendingUpdate = m_messageList.size();
+            if (message == WorkerThread::kUpdate) {
+                for (size_t i = 0; i < m_messageList.size(); ++i) {
+                    if (m_messageList[i].message == WorkerThread::kUpdate) {
+                        pendingUpdate = i;
+                        break;
+                    }
+                }
+            }
+            bool hasPendingUpdate = pendingUpdate < m_messageList.size();
+
+            if (m_queueOptions.policy == WorkerThread::OverflowPolicy::Coalesce && hasPendingUpdate) {
+                // The replaced event is released outside of the lock, by `data`.
+                m_messageList[pendingUpdate].param.swap(data);
+                // Latency is measured from the newest scene change, as that is the
+                // one which will be applied.
+                m_messageList[pendingUpdate].enqueuedAt = TimerWheel::Clock::now();
+                ++m_queueStats.coalesced;
+                return true;
+            }
+
+            // Dropping a task would break the promise chain it belongs to.
+            if (m_messageList.size() >= m_queueOptions.capacity && message != WorkerThread::kTask) {
+                if (m_queueOptions.policy != WorkerThread::OverflowPolicy::DropOldestUpdate || !hasPendingUpdate) {
+                    ++m_queueStats.rejected;
+                    return false;
+                }
+                m_messageList.erase(pendingUpdate);
+                ++m_queueStats.dropped;
+            }
+            m_messageList.pushBack(MessageData(message, std::move(data)));
+        }
+        m_queueStats.highWaterMark = std::max(m_queueStats.highWaterMark, m_messageList.size());
+    }
+    if (wasEmpty)
+        m_didReceiveMessage.notify_one();
+    return true;
+}
+
 void WorkerThreadImpl::runImpl(WorkerThreadImpl* impl) {
-#if !defined(TSW_WIN32) || !TSW_WIN32
-    // Name thread for debugging purposes. Non-win32 threads are assumed to use pthreads.
-    // File a bug if this breaks things!
-    pthread_setname_np("TSW.WorkerThread");
-#endif
+    // Name thread for debugging purposes.
+    setCurrentThreadName("TSW.WorkerThread");
+
+    // Lower the worker's priority before it does any real work, so that parsing
+    // and TLS never take CPU time from the OBS encoder and render threads.
+    const ThreadScheduling& scheduling = impl->m_scheduling;
+    if (!applyCurrentThreadScheduling(scheduling)) {
+        LOG(LOG_WARNING, "Could not fully apply worker thread scheduling (policy %s, nice %d, affinity 0x%llx)",
+            threadSchedulingPolicyName(scheduling.policy), scheduling.niceLevel,
+            static_cast<unsigned long long>(scheduling.affinityMask));
+    }
     impl->run();
 }
 
+WorkerThread::Metrics WorkerThreadImpl::metrics() {
+    std::lock_guard<std::mutex> lock(m_messageListMutex);
+    WorkerThread::Metrics metrics;
+    metrics.queue = m_queueStats;
+    metrics.queue.depth = m_messageList.size();
+    for (unsigned i = 0; i < WorkerThread::kMessageCount; ++i)
+        metrics.messages[i] = m_messageMetrics[i];
+    return metrics;
+}
+
+static double toMilliseconds(Histogram::Duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void WorkerThreadImpl::logMetricsIfChanged() {
+    WorkerThread::Metrics metrics = this->metrics();
+    uint64_t handled = 0;
+    for (auto& message : metrics.messages)
+        handled += message.queueWait.count();
+    if (handled == m_messagesHandledAtLastLog)
+        return;
+    m_messagesHandledAtLastLog = handled;
+
+    LOG(LOG_INFO, "Worker queue: depth %zu/%zu, high water mark %zu, %llu coalesced, %llu dropped, %llu rejected",
+        metrics.queue.depth, metrics.queue.capacity, metrics.queue.highWaterMark,
+        static_cast<unsigned long long>(metrics.queue.coalesced), static_cast<unsigned long long>(metrics.queue.dropped),
+        static_cast<unsigned long long>(metrics.queue.rejected));
+    for (unsigned i = 0; i < WorkerThread::kMessageCount; ++i) {
+        const WorkerThread::MessageMetrics& message = metrics.messages[i];
+        if (!message.queueWait.count())
+            continue;
+        LOG(LOG_INFO, "  %s: %llu received; p50/p99/max (ms) wait %.1f/%.1f/%.1f, processing %.1f/%.1f/%.1f, end-to-end %.1f/%.1f/%.1f",
+            WorkerThread::messageName(static_cast<WorkerThread::Message>(i)),
+            static_cast<unsigned long long>(message.queueWait.count()),
+            toMilliseconds(message.queueWait.percentile(0.5)), toMilliseconds(message.queueWait.percentile(0.99)),
+            toMilliseconds(message.queueWait.max()),
+            toMilliseconds(message.processing.percentile(0.5)), toMilliseconds(message.processing.percentile(0.99)),
+            toMilliseconds(message.processing.max()),
+            toMilliseconds(message.endToEnd.percentile(0.5)), toMilliseconds(message.endToEnd.percentile(0.99)),
+            toMilliseconds(message.endToEnd.max()));
+    }
+}
+
 void WorkerThreadImpl::run() {
+    if (m_queueOptions.metricsLogInterval > std::chrono::seconds::zero())
+        scheduleRepeatingTimer(m_queueOptions.metricsLogInterval, [this] { logMetricsIfChanged(); });
+    if (m_authOptions.validationInterval > std::chrono::seconds::zero()) {
+        scheduleTimer(TimerWheel::Duration::zero(), [this] { validateProfiles(); });
+        scheduleRepeatingTimer(m_authOptions.validationInterval, [this] { validateProfiles(); });
+    }
+    // Maps the catalog and indexes every game in it, here rather than on the
+    // main thread the first time a scene item asks for similar names.
+    scheduleTimer(TimerWheel::Duration::zero(), [this] { m_gameIndex.buildSimilarityIndex(); });
+
     while (true) {
-        MessageData event;
-        if (waitForMessage(event)) {
-            if (!handleMessage(event))
+        fireExpiredTimers();
+        if (waitForMessages(m_batch)) {
+            if (!handleBatch(m_batch))
                 break;
         }
     }
 }
 
+bool WorkerThreadImpl::handleBatch(RingBuffer<MessageData>& batch) {
+    bool result = true;
+    for (size_t i = 0; result && i < batch.size(); ++i) {
+        if (batch[i].message != WorkerThread::kNoMessage)
+            result = handleMessage(batch[i]);
+    }
+    // Releases superseded events, and anything left behind by kTerminate.
+    batch.clear();
+    return result;
+}
+
 bool WorkerThreadImpl::handleMessage(MessageData& event) {
+    WorkerThread::Message message = event.message;
+    TimerWheel::TimePoint enqueuedAt = event.enqueuedAt;
+    TimerWheel::TimePoint start = TimerWheel::Clock::now();
+    bool result = dispatchMessage(event);
+    TimerWheel::TimePoint end = TimerWheel::Clock::now();
+
+    // Updates record their latency once they are sent, which may be after
+    // other messages, see recordUpdateLatency().
+    bool didAbsorbUpdate = m_didAbsorbUpdate;
+    m_didAbsorbUpdate = false;
+    std::lock_guard<std::mutex> lock(m_messageListMutex);
+    if (!didAbsorbUpdate)
+        m_messageMetrics[message].processing.record(end - start);
+    if (message != WorkerThread::kUpdate)
+        m_messageMetrics[message].endToEnd.record(end - enqueuedAt);
+    return result;
+}
+
+bool WorkerThreadImpl::dispatchMessage(MessageData& event) {
     switch (event.message) {
     case WorkerThread::kTerminate:
         cleanup();
         return false;
 
     case WorkerThread::kUpdate:
-        if (!update(adoptRef(*event.param).cast<UpdateEvent>()))
-            return false;
+        update(adoptRef(static_cast<UpdateEvent&>(*event.param.leakRef())), event.enqueuedAt);
+        break;
+
+    case WorkerThread::kTask:
+        static_cast<TaskEvent&>(*event.param).run();
         break;
     }
     return true;
@@ -99,112 +375,113 @@ private:
     std::string m_reason;
 };
 
-bool WorkerThreadImpl::updateInternal(const std::string& accessToken, String game, String title) {
-    Http http;
-    http.
-        setHeader("Authorization", "OAuth " + accessToken).
-        setHeader("Client-Id", TSW_CLIENT_ID).
-        setHeader("content-type", "application/json").
-        setHeader("Accept", "application/vnd.twitchtv.v3+json").
-        setHeader("charsets", "utf-8");
+Ref<ChannelProfile> WorkerThreadImpl::profile(const std::string& name) {
+    auto it = m_profiles.find(name);
+    if (it != m_profiles.end())
+        return *it->second;
+    Ref<ChannelProfile> profile = ChannelProfile::create(name);
+    ProfileStore::Entry stored;
+    if (m_profileStore.find(name, stored)) {
+        profile->setAccessToken(stored.accessToken);
+        if (!stored.channelName.empty())
+            profile->setChannel(stored.channelName, stored.channelId);
+    }
+    m_profiles[name] = profile.ptr();
+    return profile;
+}
 
-    // Step 1: load the channel information that is already present, so that we know which channel to update
-    auto response = http.
-        request().
-        //setParameter("client_id", TSW_CLIENT_ID).
-        //setParameter("oauth_token", accessToken).
-        setHeader("Content-Type", "application/json").
-        setHeader("Accept", "application/vnd.twitchtv.v3+json").
-        get("https://api.twitch.tv/kraken/channel");
+void WorkerThreadImpl::saveProfiles() {
+    for (auto& pair : m_profiles) {
+        ChannelProfile& profile = *pair.second;
+        ProfileStore::Entry entry;
+        entry.accessToken = profile.accessToken();
+        profile.channel(entry.channelName, entry.channelId);
+        m_profileStore.set(profile.name(), entry);
+    }
+    m_profileStore.save();
+}
 
-    if (response.status() != 200)
+// static
+bool WorkerThreadImpl::lookUpChannel(ChannelApi& api, ChannelProfile& profile, std::string& channel, std::string& channelId) {
+    if (profile.channel(channel, channelId))
         return true;
 
-    std::string channel;
-
-    {
-        using namespace rapidjson;
-        Document doc;
-        doc.Parse(response.content());
-        auto displayName = doc.FindMember("display_name");
-        if (displayName == doc.MemberEnd()) {
-            // FIXME: Use obs localization API
-            LOG(LOG_WARNING, "Unexpected JSON response from /channel endpoint. Please file a bug at https://github.com/caitp/TwitchSwitcher");
-            return true;
-        }
-
-        channel = displayName->value.GetString();
+    // Load the channel owned by the signed-in account, so that we know which channel to update.
+    auto response = api.fetchChannel(profile, channel, channelId);
+    if (!ChannelApi::isSuccess(response)) {
+        // The token has expired or was revoked, so sign in again next time.
+        if (response.status() == 401)
+            profile.setAccessToken(std::string());
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "[%s] Could not look up channel (HTTP %d).", profile.name().c_str(), response.status());
+        return false;
     }
+    if (channel.empty()) {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Unexpected JSON response when looking up channel. Please file a bug at https://github.com/caitp/TwitchSwitcher");
+        return false;
+    }
+    profile.setChannel(channel, channelId);
+    return true;
+}
 
-    // FIXME: Use obs localization API
-    LOG(LOG_INFO, "Updating stream to game '%s' with title '%s'", game.characters(), title.characters());
-    std::string body;
-    {
-        // Create JSON object to send to Twitch.
-        // https://github.com/justintv/Twitch-API/blob/master/v3_resources/channels.md#put-channelschannel
-        using namespace rapidjson;
-        CrtAllocator allocator;
-        StringBuffer buffer(&allocator, game.length() + title.length() + 256);
-        Writer<StringBuffer> writer(buffer, &allocator);
-        writer.StartObject();
-        writer.Key("channel", 7);
-        writer.StartObject();
-        if (game.length()) {
-            writer.Key("game", 4);
-            writer.String(game.characters(), game.length());
-        }
+// static
+void WorkerThreadImpl::updateChannel(ChannelApi& api, ChannelProfile& profile, const std::string& game, const std::string& title) {
+    std::string channel;
+    std::string channelId;
+    if (!lookUpChannel(api, profile, channel, channelId))
+        return;
 
-        if (title.length()) {
-            writer.Key("status", 6);
-            writer.String(title.characters(), title.length());
-        }
-        writer.EndObject();
-        writer.EndObject();
-        body = buffer.GetString();
+    // FIXME: Use obs localization API
+    LOG(LOG_INFO, "[%s] Updating channel '%s' to game '%s' with title '%s'", profile.name().c_str(), channel.c_str(), game.c_str(), title.c_str());
+    auto response = api.updateChannel(profile, channel, channelId, game, title);
+    if (ChannelApi::isSuccess(response)) {
+        profile.didUpdate(game, title);
+        return;
     }
-    response = http.
-        request().
-        //setParameter("oauth_token", accessToken).
-        //setParameter("client_id", TSW_CLIENT_ID).
-        put("https://api.twitch.tv/kraken/channels/" + channel, body);
 
-    if (response.status() != 200) {
+    // The token may have expired, or the channel may have been renamed. Sign in
+    // or look the channel up again next time.
+    if (response.status() == 401)
+        profile.setAccessToken(std::string());
+    else if (response.status() == 404)
+        profile.invalidateChannel();
+
+    {
         // May be JSON info describing the failure.
-        using namespace rapidjson;
-        Document doc;
-        ParseResult parseResult = doc.Parse(response.content());
+        String error, message;
+        JsonExtractor extractor;
+        extractor.field("error", error).field("message", message);
         std::string result;
-        if (parseResult) {
-            auto error = doc.FindMember("error");
-            auto message = doc.FindMember("message");
-            if (error != doc.MemberEnd() && error->value.IsString())
-                result += error->value.GetString();
-            if (message != doc.MemberEnd() && message->value.IsString()) {
+        if (extractor.parse(response.content())) {
+            result += error.toStdString();
+            if (!message.isEmpty()) {
                 if (result.length())
                     result += ": ";
-                result += message->value.GetString();
+                result += message.toStdString();
             }
         }
         if (result.empty())
             result = response.content();
         // FIXME: Use obs localization API
-        LOG(LOG_WARNING, "[Twitch API] '%s'. Please file a bug at https://github.com/caitp/TwitchSwitcher", result.c_str());
+        LOG(LOG_WARNING, "[Twitch API] [%s] '%s'. Please file a bug at https://github.com/caitp/TwitchSwitcher", profile.name().c_str(), result.c_str());
     }
-    return true;
 }
 
-std::future<AuthStatus> WorkerThreadImpl::authenticateIfNeeded() {
-    auto result = std::make_shared <std::promise<AuthStatus>>();
-    std::future<AuthStatus> future = result->get_future();
-    if (m_accessToken.length()) {
-        result->set_value({ HttpResponse(200, std::string()), m_accessToken });
-        return future;
-    }
+Future<AuthStatus> WorkerThreadImpl::authenticateIfNeeded(ChannelProfile& profile) {
+    if (profile.hasAccessToken())
+        return makeReadyFuture(AuthStatus { HttpResponse(200, std::string()), profile.accessToken() });
+    return signIn(profile);
+}
+
+Future<AuthStatus> WorkerThreadImpl::signIn(ChannelProfile& profile) {
+    // A sign-in started by the validator may still be open for this profile.
+    if (isSigningIn() && m_signInProfile.get() == &profile)
+        return m_signIn;
 
     String key;
     if (!SceneWatcher::getTwitchCredentials(key)) {
-        result->set_exception(std::make_exception_ptr(SimpleException("Could not retrieve Stream Key.")));
-        return future;
+        return makeExceptionalFuture<AuthStatus>(std::make_exception_ptr(SimpleException("Could not retrieve Stream Key.")));
     }
 
     Http http;
@@ -234,8 +511,7 @@ std::future<AuthStatus> WorkerThreadImpl::authenticateIfNeeded() {
 
     if (!authUrl.c_str()) {
         // FIXME: Use obs localization API
-        result->set_exception(std::make_exception_ptr(SimpleException("Did not get redirect URI from oauth2/authorize endpoint: '%s'.")));
-        return future;
+        return makeExceptionalFuture<AuthStatus>(std::make_exception_ptr(SimpleException("Did not get redirect URI from oauth2/authorize endpoint: '%s'.")));
     }
 
     if (!m_currentWebView.isNull()) {
@@ -246,7 +522,14 @@ std::future<AuthStatus> WorkerThreadImpl::authenticateIfNeeded() {
     HttpRequestOptions signinRequest = http.request();
 
     Ref<WebView> webView = *adoptRef(new WebView());
-    signinRequest.setOnRedirect([this](const std::string& url, const std::string& body) {
+    RefPtr<ChannelProfile> protectedProfile = &profile;
+    struct RequestState : public RefCounted<RequestState> {
+        bool gotAuthToken = false;
+        bool didRedirect = false;
+    };
+
+    RefPtr<RequestState> requestState = new RequestState;
+    signinRequest.setOnRedirect([protectedProfile, requestState](const std::string& url, const std::string& body) {
         // Should gain access to authorization code here, if the URL looks a certain way...
         static const std::string redirectUri = "http://localhost";
         if (std::equal(redirectUri.begin(), redirectUri.end(), url.begin())) {
@@ -254,87 +537,498 @@ std::future<AuthStatus> WorkerThreadImpl::authenticateIfNeeded() {
             if (begin != std::string::npos) {
                 auto end = url.find('&', begin);
                 if (end == std::string::npos)
-                    this->m_accessToken = url.substr(begin + 13);
+                    protectedProfile->setAccessToken(url.substr(begin + 13));
                 else
-                    this->m_accessToken = url.substr(begin + 13, end - (begin + 13));
+                    protectedProfile->setAccessToken(url.substr(begin + 13, end - (begin + 13)));
+                // The profile may already have had a token, if it is being replaced
+                // ahead of expiry.
+                requestState->didRedirect = true;
             }
             return OnRedirect::Finish;
         }
         return OnRedirect::Follow;
     });
 
-    struct RequestState : public RefCounted<RequestState> {
-        bool gotAuthToken = false;
-    };
-
-    RefPtr<RequestState> requestState = new RequestState;
-    webView->setOnComplete([this, result, requestState](WebView& webView, String url) {
-        if (this->m_accessToken.length()) {
-            LOG(LOG_INFO, "gotAuthToken: %s\n", this->m_accessToken.c_str());
+    // Destroyed with the WebView, which breaks the promise if sign-in never
+    // finished.
+    Promise<AuthStatus> result;
+    Future<AuthStatus> future = result.future();
+    // Cancelling the future (e.g. on unload) closes the sign-in window.
+    WeakPtr<WebView> weakWebView = webView->createWeakPtr();
+    result.setOnCancel([weakWebView]() mutable {
+        if (!weakWebView.isNull())
+            weakWebView->close();
+    });
+    webView->setOnComplete([protectedProfile, result, requestState](WebView& webView, String url) mutable {
+        if (requestState->didRedirect && protectedProfile->hasAccessToken()) {
+            LOG(LOG_INFO, "gotAuthToken for profile '%s'", protectedProfile->name().c_str());
             requestState->gotAuthToken = true;
             webView.close();
-            result->set_value({ HttpResponse(200, std::string()), m_accessToken });
+            result.setValue(AuthStatus { HttpResponse(200, std::string()), protectedProfile->accessToken() });
         }
     }).
-        setOnAbort([result, requestState](WebView& webView, String url) {
+        setOnAbort([result, requestState](WebView& webView, String url) mutable {
         // Prevent hangs when a response is not going to happen.
         if (!requestState->gotAuthToken)
-            result->set_exception(std::make_exception_ptr(SimpleException("Request aborted")));
+            result.setException(std::make_exception_ptr(SimpleException("Request aborted")));
     }).
-        setTitle("Please sign in"). // FIXME: Use obs localization API
+        setTitle("Please sign in (" + profile.name() + ")"). // FIXME: Use obs localization API
         open(authUrl, signinRequest).show();
     m_currentWebView = webView;
-    return future;
+
+    // Look the channel up as soon as sign-in completes, so that the first update
+    // doesn't have to, and remember both for the next session. Runs on the worker,
+    // which owns the profile store.
+    m_signInProfile = protectedProfile;
+    m_signIn = future.then(m_executor, [this, protectedProfile](Future<AuthStatus> status) {
+        AuthStatus result = status.get();
+        std::string channel;
+        std::string channelId;
+        lookUpChannel(*m_api, *protectedProfile, channel, channelId);
+        saveProfiles();
+        return result;
+    });
+    return m_signIn;
 }
 
-bool WorkerThreadImpl::update(Ref<UpdateEvent> data) {
-    String stream = data->stream();
-    String game = data->game();
-    String title = data->title();
-    LOG(LOG_DEBUG, "Updating stream '%s'\n      Game = '%s'\n    Status = '%s'", stream.characters(), game.characters(), title.characters());
-    auto accessTokenFuture = authenticateIfNeeded();
-    while (true) {
-        // Nested message loop, special casing the Update message.
-        MessageData event;
-        if (waitForMessage(event, std::chrono::milliseconds(300))) {
-            if (event.message == WorkerThread::kUpdate) {
-                data = adoptRef(*event.param).cast<UpdateEvent>();
-                // When sign-in is complete, will use the event data from the
-                // most recent event.
-                game = data->game();
-                title = data->title();
-            } else {
-                if (!handleMessage(event))
-                    return false;
+// static
+WorkerThreadImpl::TokenStatus WorkerThreadImpl::validateToken(const ChannelProfile& profile, const std::string& url,
+                                                              std::chrono::seconds& expiresIn) {
+    Http http;
+    auto response = http.
+        request().
+        setHeader("Authorization", "OAuth " + profile.accessToken()).
+        setHeader("Client-Id", TSW_CLIENT_ID).
+        get(url);
+
+    if (response.status() == 401)
+        return TokenStatus::Invalid;
+    if (response.status() != 200)
+        return TokenStatus::Unknown;
+
+    // Tokens which never expire report no expiry, or zero.
+    expiresIn = std::chrono::seconds::zero();
+    String expiry;
+    JsonExtractor extractor;
+    extractor.field("expires_in", expiry);
+    if (extractor.parse(response.content()) && !expiry.isEmpty())
+        expiresIn = std::chrono::seconds(std::strtoull(expiry.c_str(), nullptr, 10));
+    return TokenStatus::Valid;
+}
+
+void WorkerThreadImpl::validateProfiles() {
+    // Profiles saved by a previous session are checked before their first update.
+    for (auto& name : m_profileStore.profiles())
+        profile(name);
+
+    for (auto& pair : m_profiles) {
+        Ref<ChannelProfile> profile = *pair.second;
+        if (!profile->hasAccessToken())
+            continue;
+
+        std::chrono::seconds expiresIn;
+        bool shouldSignIn = false;
+        switch (validateToken(profile, m_authOptions.validationUrl, expiresIn)) {
+        case TokenStatus::Valid:
+            if (expiresIn > std::chrono::seconds::zero() && expiresIn <= m_authOptions.refreshMargin) {
+                // FIXME: Use obs localization API
+                LOG(LOG_INFO, "[%s] Access token expires in %lld minutes, signing in again.", profile->name().c_str(),
+                    static_cast<long long>(std::chrono::duration_cast<std::chrono::minutes>(expiresIn).count()));
+                shouldSignIn = true;
             }
-        }
-        if (accessTokenFuture.wait_for(std::chrono::milliseconds(300)) == std::future_status::ready)
             break;
+
+        case TokenStatus::Invalid:
+            // FIXME: Use obs localization API
+            LOG(LOG_INFO, "[%s] Access token is no longer valid, signing in again.", profile->name().c_str());
+            profile->setAccessToken(std::string());
+            shouldSignIn = true;
+            break;
+
+        case TokenStatus::Unknown:
+            // Offline, or the endpoint is unavailable. Try again next time.
+            break;
+        }
+
+        // Only one sign-in window is open at a time. Any other profile which needs
+        // one is picked up by the next validation, or by its next update.
+        if (shouldSignIn && !isSigningIn())
+            signIn(profile);
+    }
+    saveProfiles();
+}
+
+bool WorkerThreadImpl::resolveUpdate(const UpdateEvent& data, SceneUpdate& update) {
+    if (!SceneWatcher::shouldUpdate(data))
+        return false;
+
+    // The event holds a reference to the source, which keeps the item alive.
+    TSWSceneItem* item = TSWSceneItem::fromSource(data.item());
+    if (item == nullptr)
+        return false;
+
+    item->snapshot(update.game, update.title, update.profiles);
+    LOG(LOG_DEBUG, "Updating stream '%s'\n      Game = '%s'\n    Status = '%s'", data.stream().characters(), update.game.c_str(), update.title.c_str());
+    return true;
+}
+
+void WorkerThreadImpl::update(Ref<UpdateEvent> data, TimerWheel::TimePoint enqueuedAt) {
+    if (m_pendingUpdate) {
+        PendingUpdate& pending = *m_pendingUpdate;
+        m_didAbsorbUpdate = true;
+        if (pending.isSending) {
+            pending.next = data.ptr();
+            pending.nextEnqueuedAt = enqueuedAt;
+        } else {
+            pending.data = data.ptr();
+            pending.didAbsorb = true;
+            pending.absorbedEnqueuedAt = enqueuedAt;
+        }
+        return;
+    }
+
+    std::unique_ptr<PendingUpdate> pending(new PendingUpdate);
+    if (!resolveUpdate(data, pending->update)) {
+        recordUpdateLatency(enqueuedAt);
+        return;
     }
+    pending->data = data.ptr();
+    pending->resolved = data.ptr();
+    pending->enqueuedAt = enqueuedAt;
+    pending->names = ChannelProfile::parseNames(pending->update.profiles);
+    m_pendingUpdate = std::move(pending);
+    authenticateProfiles();
+}
 
-    std::string accessToken;
+void WorkerThreadImpl::authenticateProfiles() {
+    PendingUpdate& pending = *m_pendingUpdate;
+    while (pending.nextProfile < pending.names.size()) {
+        // Profiles which are already signed in have a ready future, and carry on
+        // without going through the message loop.
+        auto accessTokenFuture = authenticateIfNeeded(profile(pending.names[pending.nextProfile]));
+        if (!accessTokenFuture.isReady()) {
+            pending.step = accessTokenFuture.then(m_executor, [this](Future<AuthStatus> status) {
+                didAuthenticate(status);
+                authenticateProfiles();
+            });
+            return;
+        }
+        didAuthenticate(accessTokenFuture);
+    }
+    sendUpdate();
+}
 
+void WorkerThreadImpl::didAuthenticate(const Future<AuthStatus>& status) {
+    PendingUpdate& pending = *m_pendingUpdate;
+    const std::string& name = pending.names[pending.nextProfile++];
+    // Profiles which fail to authenticate are skipped.
     try {
-        AuthStatus status = accessTokenFuture.get();
-        accessToken = status.accessToken;
+        status.get();
+        pending.profiles.push_back(profile(name));
     } catch (const SimpleException& e) {
         // FIXME: Use obs localization API
-        LOG(LOG_WARNING, "Authorization failed: %s. Please file a bug at https://github.com/caitp/TwitchSwitcher", e.reason().c_str());
+        LOG(LOG_WARNING, "Authorization failed for profile '%s': %s. Please file a bug at https://github.com/caitp/TwitchSwitcher", name.c_str(), e.reason().c_str());
+    } catch (const FutureError& e) {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Aborted getting access token for profile '%s': %s.", name.c_str(), e.what());
+    }
+}
+
+void WorkerThreadImpl::sendUpdate() {
+    PendingUpdate& pending = *m_pendingUpdate;
+    SceneUpdate& update = pending.update;
+
+    // A newer update may have arrived while signing in, or while searching for
+    // the game. It is sent to the profiles which were resolved for the original
+    // one.
+    if (pending.data.get() != pending.resolved.get()) {
+        if (!resolveUpdate(*pending.data, update)) {
+            finishUpdate();
+            return;
+        }
+        pending.resolved = pending.data;
+    }
+
+    if (!pending.profiles.empty() && !resolveGame(update.game)) {
+        // The game was typed before any typeahead search could find it, or came
+        // from a scene collection. Ask the API about it.
+        std::string game = update.game;
+        pending.step = startGameSearch(pending.profiles.front()->accessToken(), game, m_updateThreads).
+            then(m_executor, [this, game](Future<GameSearch> search) {
+            didSearchGame(game, search.get());
+        });
+        return;
+    }
+    startSending();
+}
+
+void WorkerThreadImpl::didSearchGame(const std::string& game, const GameSearch& search) {
+    PendingUpdate& pending = *m_pendingUpdate;
+    std::string canonical;
+    bool found = false;
+    if (search.succeeded) {
+        m_gameIndex.add(game, search.games, search.complete);
+        found = m_gameIndex.resolve(game, canonical);
+        if (!found)
+            m_unknownGames[GameIndex::normalize(game)] = TimerWheel::Clock::now();
+    }
+
+    // A newer update is resolved again, and finds this search's outcome in the
+    // index or among the unknown games.
+    if (pending.data.get() != pending.resolved.get()) {
+        sendUpdate();
+        return;
+    }
+    // If the API can't be reached, the game is sent as it is.
+    if (found)
+        pending.update.game = canonical;
+    else if (search.succeeded)
+        dropUnknownGame(pending.update.game);
+    startSending();
+}
+
+void WorkerThreadImpl::startSending() {
+    PendingUpdate& pending = *m_pendingUpdate;
+    SceneUpdate& update = pending.update;
+    pending.isSending = true;
+    pending.step = fanOutUpdate(pending.profiles, update.game, update.title).then(m_executor, [this](Future<void>) {
+        // Profiles may have looked up their channel, or lost their token, and new
+        // games may have been resolved.
+        saveProfiles();
+        m_gameIds.save();
+        finishUpdate();
+    });
+}
+
+void WorkerThreadImpl::finishUpdate() {
+    std::unique_ptr<PendingUpdate> pending = std::move(m_pendingUpdate);
+    recordUpdateLatency(pending->enqueuedAt);
+    if (pending->didAbsorb)
+        recordUpdateLatency(pending->absorbedEnqueuedAt);
+    if (pending->next)
+        update(Ref<UpdateEvent>(*pending->next), pending->nextEnqueuedAt);
+}
+
+void WorkerThreadImpl::recordUpdateLatency(TimerWheel::TimePoint enqueuedAt) {
+    TimerWheel::TimePoint end = TimerWheel::Clock::now();
+    std::lock_guard<std::mutex> lock(m_messageListMutex);
+    m_messageMetrics[WorkerThread::kUpdate].endToEnd.record(end - enqueuedAt);
+}
+
+bool WorkerThreadImpl::resolveGame(std::string& game) {
+    // In case an update arrives before the index was built.
+    m_gameIndex.buildSimilarityIndex();
+    std::string canonical;
+    if (game.empty() || m_gameIndex.resolve(game, canonical)) {
+        if (!game.empty())
+            game = canonical;
         return true;
-    } catch (const std::future_error& e) {
-        if (e.code() == std::future_errc::broken_promise) {
+    }
+
+    auto unknown = m_unknownGames.find(GameIndex::normalize(game));
+    if (unknown == m_unknownGames.end())
+        return false;
+    if (TimerWheel::Clock::now() - unknown->second >= kUnknownGameTimeout) {
+        m_unknownGames.erase(unknown);
+        return false;
+    }
+    dropUnknownGame(game);
+    return true;
+}
+
+// static
+const std::chrono::minutes WorkerThreadImpl::kUnknownGameTimeout(10);
+
+void WorkerThreadImpl::dropUnknownGame(std::string& game) {
+    std::vector<std::string> similar;
+    if (m_gameIndex.findSimilar(game, similar)) {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Unknown game '%s' (did you mean '%s'?), only updating the title.", game.c_str(), similar.front().c_str());
+    } else {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Unknown game '%s', only updating the title.", game.c_str());
+    }
+    game.clear();
+}
+
+static void reapFinishedThreads(std::vector<std::future<void>>& threads) {
+    for (auto thread = threads.begin(); thread != threads.end();) {
+        if (thread->wait_for(std::chrono::seconds::zero()) == std::future_status::ready)
+            thread = threads.erase(thread);
+        else
+            ++thread;
+    }
+}
+
+Future<void> WorkerThreadImpl::fanOutUpdate(std::vector<Ref<ChannelProfile>>& profiles, const std::string& game, const std::string& title) {
+    reapFinishedThreads(m_updateThreads);
+    std::vector<Future<void>> pending;
+    for (auto& profile : profiles) {
+        if (profile->isUpToDate(game, title))
+            continue;
+
+        RefPtr<ChannelApi> api = m_api;
+        RefPtr<ChannelProfile> protectedProfile = profile.ptr();
+        ThreadScheduling scheduling = m_scheduling;
+        Promise<void> done;
+        pending.push_back(done.future());
+        m_updateThreads.push_back(std::async(std::launch::async, [api, protectedProfile, game, title, scheduling, done]() mutable {
+            // Held to the worker's priority. runImpl() already warned if it
+            // can't be applied.
+            applyCurrentThreadScheduling(scheduling);
+            // The update is done once every request has settled, however it
+            // settled.
+            try {
+                updateChannel(*api, *protectedProfile, game, title);
+            } catch (...) {
+                done.setException(std::current_exception());
+                return;
+            }
+            done.setValue();
+        }));
+    }
+    return whenAll(pending);
+}
+
+// static
+const std::chrono::milliseconds WorkerThreadImpl::kTypeaheadDebounce(300);
+
+// static
+const std::chrono::seconds WorkerThreadImpl::kGameCatalogSaveDelay(30);
+
+void WorkerThreadImpl::suggestGames(Ref<TypeaheadRequest> request) {
+    obs_source* item = request->item();
+    PendingTypeahead& pending = m_typeaheads[item];
+    if (pending.timer)
+        cancelTimer(*pending.timer);
+    if (pending.search.isValid())
+        pending.search.cancel();
+
+    // Queries which extend an earlier search are answered without waiting.
+    std::vector<std::string> names;
+    if (request->query().empty() || m_gameIndex.find(request->query(), names)) {
+        m_typeaheads.erase(item);
+        obs_source_update_properties(item);
+        return;
+    }
+
+    pending.request = request.ptr();
+    pending.search = Future<void>();
+    pending.timer = scheduleTimer(kTypeaheadDebounce, [this, item] { startTypeahead(item); }).ptr();
+}
+
+void WorkerThreadImpl::startTypeahead(obs_source* item) {
+    auto it = m_typeaheads.find(item);
+    if (it == m_typeaheads.end())
+        return;
+    PendingTypeahead& pending = it->second;
+    pending.timer = nullptr;
+
+    RefPtr<TypeaheadRequest> request = pending.request;
+
+    // Searching doesn't open a sign-in window: the default profile's token is
+    // used if it has one.
+    std::string accessToken = profile(ChannelProfile::kDefaultName)->accessToken();
+
+    pending.search = startGameSearch(accessToken, request->query(), m_typeaheadThreads).
+        then(m_executor, [this, request](Future<GameSearch> search) {
+        finishTypeahead(*request, search.get());
+    });
+}
+
+Future<WorkerThreadImpl::GameSearch> WorkerThreadImpl::startGameSearch(const std::string& accessToken, const std::string& query,
+                                                                       std::vector<std::future<void>>& threads) {
+    reapFinishedThreads(threads);
+
+    // Cancelling the search aborts its request, so a superseded search doesn't
+    // keep its thread busy.
+    HttpCancelFlag cancelled = std::make_shared<std::atomic<bool>>(false);
+    Promise<GameSearch> search;
+    search.setOnCancel([cancelled] { cancelled->store(true); });
+
+    RefPtr<ChannelApi> api = m_api;
+    ThreadScheduling scheduling = m_scheduling;
+    threads.push_back(std::async(std::launch::async, [api, accessToken, query, cancelled, search, scheduling]() mutable {
+        // A search per keystroke shouldn't outrank the encoder either.
+        applyCurrentThreadScheduling(scheduling);
+        GameSearch result;
+        auto response = api->searchGames(accessToken, query, cancelled, result.games);
+        result.succeeded = ChannelApi::isSuccess(response);
+        if (result.succeeded) {
+            result.complete = api->isCompleteSearch(result.games);
+        } else if (!cancelled->load()) {
             // FIXME: Use obs localization API
-            LOG(LOG_WARNING, "Aborted getting access token.");
+            LOG(LOG_DEBUG, "Game search for '%s' failed (%d).", query.c_str(), response.status());
         }
-        return true;
+        search.setValue(std::move(result));
+    }));
+    return search.future();
+}
+
+void WorkerThreadImpl::finishTypeahead(const TypeaheadRequest& request, const GameSearch& search) {
+    auto it = m_typeaheads.find(request.item());
+    if (it == m_typeaheads.end() || it->second.request.get() != &request)
+        return;
+
+    // The properties are rebuilt from the index, with whatever the game field
+    // holds by then.
+    if (search.succeeded)
+        m_gameIndex.add(request.query(), search.games, search.complete);
+    obs_source_update_properties(request.item());
+    m_typeaheads.erase(it);
+    if (!search.succeeded)
+        return;
+
+    if (!m_gameCatalogSave)
+        m_gameCatalogSave = scheduleTimer(kGameCatalogSaveDelay, [this] { saveGameCatalog(); }).ptr();
+}
+
+void WorkerThreadImpl::saveGameCatalog() {
+    m_gameCatalogSave = nullptr;
+    m_unknownGames.clear();
+    if (!m_gameIndex.save()) {
+        // FIXME: Use obs localization API
+        LOG(LOG_WARNING, "Could not write game catalog '%s'.", m_authOptions.gameCatalogPath.c_str());
     }
+}
 
-    return updateInternal(accessToken, game, title);
+void WorkerThreadImpl::cancelTypeaheads() {
+    for (auto& pair : m_typeaheads) {
+        if (pair.second.timer)
+            cancelTimer(*pair.second.timer);
+        if (pair.second.search.isValid())
+            pair.second.search.cancel();
+    }
+    m_typeaheads.clear();
+    for (auto& thread : m_typeaheadThreads)
+        thread.wait();
+    m_typeaheadThreads.clear();
 }
 
 void WorkerThreadImpl::cleanup() {
+    // An update waiting for sign-in is dropped, and one being sent is left to
+    // finish its requests.
+    if (m_pendingUpdate) {
+        if (m_pendingUpdate->step.isValid())
+            m_pendingUpdate->step.cancel();
+        m_pendingUpdate = nullptr;
+    }
+    for (auto& thread : m_updateThreads)
+        thread.wait();
+    m_updateThreads.clear();
+    // The validator may have opened a sign-in window with no update waiting on
+    // it. Closing the window finishes sign-in later, on the UI thread, by which
+    // time this object is gone, so the continuation must be detached first.
+    if (m_signIn.isValid())
+        m_signIn.cancel();
+    m_signInProfile = nullptr;
     if (!m_currentWebView.isNull())
         m_currentWebView->close();
+    cancelTypeaheads();
+    if (m_gameCatalogSave) {
+        cancelTimer(*m_gameCatalogSave);
+        saveGameCatalog();
+    }
 }
 
 }  // namespace twitchsw
@@ -0,0 +1,121 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+// Compares escaping a corpus of stream titles and game names with rapidjson's
+// Writer, with a byte-at-a-time loop over the same table as writeJsonEscaped(),
+// and with writeJsonEscaped() itself, which skips over clean runs a vector at a
+// time when built with SSE2 or AVX2.
+//
+// Usage: escape_benchmark [iterations]
+
+#include <twitchsw/jsontemplate.h>
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace twitchsw;
+typedef std::chrono::steady_clock Clock;
+
+static const char* const kCorpus[] = {
+    "Overwatch",
+    "The Legend of Zelda: Breath of the Wild",
+    "Tom Clancy's Rainbow Six Siege",
+    "100% run, no major glitches \xe2\x80\x94 day 3 | !schedule !discord \"chill vibes\"",
+    "\xf0\x9f\x94\xb4 LIVE \xf0\x9f\x94\xb4 Ranked grind to Grandmaster \xe2\x80\x94 road to top 500 (EU) | !socials !merch",
+    "[ENG/ESP] Speedrunning Celeste any% \xe2\x80\x94 PB attempts all night, 27:xx goal | C:\\Users\\me\\splits.lss",
+    "\xe3\x80\x90\xe5\x88\x9d\xe8\xa6\x8b\xe3\x80\x91\xe3\x82\xa8\xe3\x83\xab\xe3\x83\x87\xe3\x83\xb3\xe3\x83\xaa"
+    "\xe3\x83\xb3\xe3\x82\xb0 \xe5\xae\x9f\xe6\xb3\x81 #12 \xe2\x80\x94 \xe3\x83\x9e\xe3\x83\xac\xe3\x83\x8b\xe3\x82\xa2",
+    "just chatting :) ask me anything, Q&A + reacting to your clips w/ the squad",
+    "Multi-line\ttitle from a\r\npaste \\o/",
+    "S P E E D R U N S   A N D   C H I L L   \xe2\x98\x85\xe2\x98\x85\xe2\x98\x85 Super Mario 64 120 star "
+    "\xe2\x80\x94 sub 1:40 attempts, !race !pb !wr !commands | sponsored by nobody, funded by coffee \xe2\x98\x95",
+};
+
+// The loop writeJsonEscaped() used before it was vectorized.
+static char* escapeByteAtATime(char* out, const char* characters, size_t length) {
+    static const char kHexDigits[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(characters[i]);
+        char escape = c < 0x20 ? (c == '\b' ? 'b' : c == '\t' ? 't' : c == '\n' ? 'n' : c == '\f' ? 'f' : c == '\r' ? 'r' : 'u')
+            : c == '"' ? '"' : c == '\\' ? '\\' : 0;
+        if (!escape) {
+            *out++ = static_cast<char>(c);
+            continue;
+        }
+        *out++ = '\\';
+        *out++ = escape;
+        if (escape == 'u') {
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = kHexDigits[c >> 4];
+            *out++ = kHexDigits[c & 0xF];
+        }
+    }
+    return out;
+}
+
+template <typename Function>
+static void run(const char* name, unsigned iterations, size_t bytes, Function function) {
+    function();
+    auto start = Clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        function();
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    std::printf("%-16s %12.1f %12.2f\n", name, elapsed / iterations,
+        static_cast<double>(bytes) * iterations / elapsed);
+}
+
+int main(int argc, char** argv) {
+    unsigned iterations = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 200000;
+    std::vector<std::string> corpus(std::begin(kCorpus), std::end(kCorpus));
+    size_t bytes = 0;
+    for (auto& string : corpus)
+        bytes += string.length();
+
+    // Large enough for any string escaped as \u00XX.
+    std::string out(bytes * 6, '\0');
+    volatile size_t sink = 0;
+
+    std::printf("%u iterations over %zu strings, %zu bytes\n\n", iterations, corpus.size(), bytes);
+    std::printf("%-16s %12s %12s\n", "", "ns/corpus", "bytes/ns");
+
+    run("rapidjson", iterations, bytes, [&] {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartArray();
+        for (auto& string : corpus)
+            writer.String(string.data(), static_cast<rapidjson::SizeType>(string.length()));
+        writer.EndArray();
+        sink = sink + buffer.GetSize();
+    });
+    run("byte at a time", iterations, bytes, [&] {
+        char* end = &out[0];
+        for (auto& string : corpus)
+            end = escapeByteAtATime(end, string.data(), string.length());
+        sink = sink + static_cast<size_t>(end - out.data());
+    });
+    run("writeJsonEscaped", iterations, bytes, [&] {
+        char* end = &out[0];
+        for (auto& string : corpus)
+            end = writeJsonEscaped(end, string.data(), string.length());
+        sink = sink + static_cast<size_t>(end - out.data());
+    });
+    run("measure + write", iterations, bytes, [&] {
+        char* end = &out[0];
+        for (auto& string : corpus) {
+            sink = sink + jsonEscapedLength(string.data(), string.length());
+            end = writeJsonEscaped(end, string.data(), string.length());
+        }
+        sink = sink + static_cast<size_t>(end - out.data());
+    });
+    return 0;
+}
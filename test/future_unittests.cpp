@@ -0,0 +1,214 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/future.h>
+
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace twitchsw;
+
+// Runs tasks only when drained, to check which executor continuations run on.
+class QueueExecutor : public Executor {
+public:
+    void post(std::function<void()>&& task) override { m_tasks.push_back(std::move(task)); }
+
+    size_t drain() {
+        size_t count = 0;
+        while (!m_tasks.empty()) {
+            auto task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            task();
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::deque<std::function<void()>> m_tasks;
+};
+
+TEST(TSW_FUTURE, SET_VALUE) {
+    Promise<int> promise;
+    Future<int> future = promise.future();
+    EXPECT_FALSE(future.isReady());
+    EXPECT_TRUE(promise.setValue(42));
+    EXPECT_FALSE(promise.setValue(43));
+    EXPECT_TRUE(future.isReady());
+    EXPECT_EQ(42, future.get());
+    EXPECT_EQ(42, future.get());
+}
+
+TEST(TSW_FUTURE, THEN_RUNS_ON_EXECUTOR) {
+    QueueExecutor executor;
+    Promise<int> promise;
+    Future<std::string> result = promise.future().then(executor, [](Future<int> value) {
+        return std::to_string(value.get() * 2);
+    });
+
+    promise.setValue(21);
+    EXPECT_FALSE(result.isReady());
+    EXPECT_EQ(1u, executor.drain());
+    ASSERT_TRUE(result.isReady());
+    EXPECT_EQ("42", result.get());
+}
+
+TEST(TSW_FUTURE, THEN_ON_READY_FUTURE) {
+    Future<void> result = makeReadyFuture(1).then(InlineExecutor::shared(), [](Future<int>) { });
+    EXPECT_TRUE(result.isReady());
+    result.get();
+}
+
+TEST(TSW_FUTURE, THEN_UNWRAPS_FUTURES) {
+    QueueExecutor executor;
+    Promise<int> first;
+    Promise<int> second;
+    Future<int> result = first.future().then(executor, [&second](Future<int> value) {
+        EXPECT_EQ(1, value.get());
+        return second.future();
+    }).then(executor, [](Future<int> value) {
+        return value.get() + 1;
+    });
+
+    first.setValue(1);
+    executor.drain();
+    EXPECT_FALSE(result.isReady());
+    second.setValue(41);
+    executor.drain();
+    ASSERT_TRUE(result.isReady());
+    EXPECT_EQ(42, result.get());
+}
+
+TEST(TSW_FUTURE, EXCEPTIONS_PROPAGATE) {
+    Promise<int> promise;
+    Future<int> result = promise.future().then(InlineExecutor::shared(), [](Future<int> value) {
+        return value.get() + 1;
+    });
+    promise.setException(std::make_exception_ptr(std::runtime_error("failed")));
+    ASSERT_TRUE(result.isReady());
+    EXPECT_THROW(result.get(), std::runtime_error);
+
+    Future<void> thrown = makeReadyFuture(1).then(InlineExecutor::shared(), [](Future<int>) {
+        throw std::logic_error("thrown");
+    });
+    EXPECT_THROW(thrown.get(), std::logic_error);
+}
+
+TEST(TSW_FUTURE, BROKEN_PROMISE) {
+    Future<int> future;
+    {
+        Promise<int> promise;
+        future = promise.future();
+        Promise<int> copy = promise;
+    }
+    ASSERT_TRUE(future.isReady());
+    try {
+        future.get();
+        FAIL();
+    } catch (const FutureError& e) {
+        EXPECT_EQ(FutureError::Code::BrokenPromise, e.code());
+    }
+}
+
+TEST(TSW_FUTURE, CANCEL) {
+    Promise<int> promise;
+    bool producerCancelled = false;
+    promise.setOnCancel([&] { producerCancelled = true; });
+    bool continuationRan = false;
+    Future<int> future = promise.future();
+    Future<void> result = future.then(InlineExecutor::shared(), [&](Future<int>) { continuationRan = true; });
+
+    EXPECT_TRUE(future.cancel());
+    EXPECT_TRUE(producerCancelled);
+    EXPECT_TRUE(promise.isCancelled());
+    EXPECT_FALSE(promise.setValue(1));
+    EXPECT_FALSE(continuationRan);
+    EXPECT_TRUE(result.isCancelled());
+    EXPECT_THROW(future.get(), FutureError);
+}
+
+TEST(TSW_FUTURE, CANCEL_PROPAGATES_UPSTREAM) {
+    Promise<int> promise;
+    Future<int> result = promise.future().then(InlineExecutor::shared(), [](Future<int> value) {
+        return value.get();
+    });
+    EXPECT_TRUE(result.cancel());
+    EXPECT_TRUE(promise.isCancelled());
+}
+
+// As the worker unloads while a sign-in window is open: the continuation is
+// cancelled, its executor is destroyed, and only then does the window report.
+TEST(TSW_FUTURE, CANCEL_DETACHES_FROM_EXECUTOR) {
+    std::unique_ptr<QueueExecutor> executor(new QueueExecutor);
+    Promise<std::string> signIn;
+    bool windowClosed = false;
+    signIn.setOnCancel([&] { windowClosed = true; });
+    bool continuationRan = false;
+    Future<std::string> result = signIn.future().then(*executor, [&](Future<std::string> token) {
+        continuationRan = true;
+        return token.get();
+    });
+
+    EXPECT_TRUE(result.cancel());
+    EXPECT_TRUE(windowClosed);
+    EXPECT_EQ(0u, executor->drain());
+    executor.reset();
+
+    EXPECT_FALSE(signIn.setValue("token"));
+    EXPECT_FALSE(signIn.setException(std::make_exception_ptr(std::runtime_error("Request aborted"))));
+    EXPECT_FALSE(continuationRan);
+}
+
+TEST(TSW_FUTURE, WHEN_ALL) {
+    std::vector<Promise<int>> promises(3);
+    std::vector<Future<int>> futures;
+    for (auto& promise : promises)
+        futures.push_back(promise.future());
+
+    Future<void> all = whenAll(futures);
+    promises[2].setValue(2);
+    promises[0].setException(std::make_exception_ptr(std::runtime_error("failed")));
+    EXPECT_FALSE(all.isReady());
+    promises[1].setValue(1);
+    EXPECT_TRUE(all.isReady());
+
+    EXPECT_TRUE(whenAll(std::vector<Future<int>>()).isReady());
+}
+
+TEST(TSW_FUTURE, WHEN_ANY) {
+    std::vector<Promise<void>> promises(3);
+    std::vector<Future<void>> futures;
+    for (auto& promise : promises)
+        futures.push_back(promise.future());
+
+    Future<size_t> any = whenAny(futures);
+    EXPECT_FALSE(any.isReady());
+    promises[1].setValue();
+    ASSERT_TRUE(any.isReady());
+    EXPECT_EQ(1u, any.get());
+    promises[0].setValue();
+    EXPECT_EQ(1u, any.get());
+}
+
+TEST(TSW_FUTURE, WHEN_ALL_CANCEL) {
+    Promise<int> promise;
+    Future<void> all = whenAll(std::vector<Future<int>>({ promise.future() }));
+    EXPECT_TRUE(all.cancel());
+    EXPECT_TRUE(promise.isCancelled());
+}
+
+TEST(TSW_FUTURE, ACROSS_THREADS) {
+    Promise<int> promise;
+    Future<int> result = promise.future().then(InlineExecutor::shared(), [](Future<int> value) {
+        return value.get() + 1;
+    });
+    std::thread producer([promise]() mutable { promise.setValue(41); });
+    EXPECT_EQ(42, result.get());
+    producer.join();
+}
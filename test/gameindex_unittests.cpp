@@ -0,0 +1,248 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/file.h>
+#include <twitchsw/gameindex.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace twitchsw;
+
+static GameSuggestion game(const char* name, uint64_t popularity = 0) {
+    GameSuggestion suggestion;
+    suggestion.name = name;
+    suggestion.popularity = popularity;
+    return suggestion;
+}
+
+TEST(TSW_GAME_INDEX, NORMALIZE) {
+    EXPECT_EQ("counter strike global offensive", GameIndex::normalize("Counter-Strike: Global Offensive"));
+    EXPECT_EQ("overwatch", GameIndex::normalize("  OVERWATCH  "));
+    EXPECT_EQ("pok\xc3\xa9mon go", GameIndex::normalize("Pok\xc3\xa9mon GO"));
+    EXPECT_EQ("", GameIndex::normalize(" - "));
+}
+
+TEST(TSW_GAME_INDEX, MISSES_UNSEARCHED_QUERIES) {
+    GameIndex index;
+    std::vector<std::string> names;
+    EXPECT_FALSE(index.find("over", names));
+
+    index.add("over", { game("Overwatch"), game("Overcooked") }, true);
+    EXPECT_FALSE(index.find("ov", names));
+    EXPECT_FALSE(index.find("portal", names));
+    EXPECT_FALSE(index.find("", names));
+
+    // Extends a searched query, but nothing local matches.
+    EXPECT_FALSE(index.find("overlord", names));
+    EXPECT_TRUE(names.empty());
+}
+
+TEST(TSW_GAME_INDEX, FINDS_EXTENSIONS_OF_SEARCHED_QUERIES) {
+    GameIndex index;
+    index.add("over", { game("Overwatch"), game("Overcooked"), game("Game Over") }, true);
+
+    std::vector<std::string> names;
+    EXPECT_TRUE(index.find("Over", names));
+    EXPECT_EQ((std::vector<std::string> { "Overwatch", "Overcooked", "Game Over" }), names);
+
+    names.clear();
+    EXPECT_TRUE(index.find("overw", names));
+    EXPECT_EQ((std::vector<std::string> { "Overwatch" }), names);
+
+    // A search which found nothing is still answered locally.
+    index.add("zzz", {}, true);
+    names.clear();
+    EXPECT_TRUE(index.find("zzz", names));
+    EXPECT_TRUE(names.empty());
+}
+
+static std::vector<GameSuggestion> fullPage(const char* first, const char* prefix) {
+    std::vector<GameSuggestion> games { game(first) };
+    for (int i = 1; i < 20; ++i)
+        games.push_back(game((prefix + std::to_string(i)).c_str()));
+    return games;
+}
+
+TEST(TSW_GAME_INDEX, FULL_PAGES_ONLY_ANSWER_THEIR_QUERY) {
+    GameIndex index;
+    index.add("m", fullPage("Mario Kart", "Minecraft "), false);
+
+    std::vector<std::string> names;
+    EXPECT_TRUE(index.find("m", names));
+    EXPECT_EQ(10u, names.size());
+
+    // The page may have left out other games starting with "mario".
+    names.clear();
+    EXPECT_FALSE(index.find("mario", names));
+    EXPECT_TRUE(names.empty());
+    EXPECT_TRUE(index.find("minecraft", names));
+    EXPECT_EQ(10u, names.size());
+    names.clear();
+    EXPECT_TRUE(index.find("mario", names, 1));
+    EXPECT_EQ((std::vector<std::string> { "Mario Kart" }), names);
+
+    // A short page is every match.
+    index.add("mario", { game("Mario Kart"), game("Super Mario 64") }, true);
+    names.clear();
+    EXPECT_TRUE(index.find("mario k", names));
+    EXPECT_EQ((std::vector<std::string> { "Mario Kart" }), names);
+}
+
+TEST(TSW_GAME_INDEX, RANKS_BY_POPULARITY) {
+    GameIndex index;
+    index.add("dark", { game("Dark Souls", 10), game("Darkest Dungeon", 500), game("Dark Souls III", 10) }, true);
+    index.add("dark souls", { game("Dark Souls III", 900) }, true);
+
+    std::vector<std::string> names;
+    EXPECT_TRUE(index.find("dark", names));
+    EXPECT_EQ((std::vector<std::string> { "Dark Souls III", "Darkest Dungeon", "Dark Souls" }), names);
+    EXPECT_EQ(3u, index.size());
+
+    names.clear();
+    EXPECT_TRUE(index.find("dark", names, 1));
+    EXPECT_EQ((std::vector<std::string> { "Dark Souls III" }), names);
+}
+
+TEST(TSW_GAME_INDEX, CLEARS_WHEN_FULL) {
+    GameIndex index(std::string(), 2);
+    index.add("a", { game("Alpha"), game("Apex") }, true);
+    index.add("b", { game("Bravo") }, true);
+    EXPECT_EQ(1u, index.size());
+
+    std::vector<std::string> names;
+    EXPECT_FALSE(index.find("a", names));
+    EXPECT_TRUE(index.find("b", names));
+    EXPECT_EQ((std::vector<std::string> { "Bravo" }), names);
+}
+
+TEST(TSW_GAME_INDEX, COMPARE_PREFIX) {
+    // Padded, as the catalog's pool and prefixes are.
+    char key[48] = "counter strike global offensive";
+    char prefix[48] = { 0 };
+    auto compare = [&](const char* text) {
+        std::memset(prefix, 0, sizeof(prefix));
+        std::strcpy(prefix, text);
+        return GameCatalog::comparePrefix(key, std::strlen(key), prefix, std::strlen(prefix));
+    };
+    EXPECT_EQ(0, compare("c"));
+    EXPECT_EQ(0, compare("counter strike global"));
+    EXPECT_EQ(0, compare("counter strike global offensive"));
+    EXPECT_GT(0, compare("counter strike global offensive 2"));
+    EXPECT_LT(0, compare("counter strike global defensive"));
+    EXPECT_GT(0, compare("counter strike z"));
+    EXPECT_LT(0, compare("counter strike \x01"));
+
+    // Bytes past ASCII order after it.
+    std::strcpy(key, "pok\xc3\xa9mon");
+    EXPECT_GT(0, compare("pok\xc3\xa9mon go"));
+    EXPECT_LT(0, compare("poke"));
+}
+
+class TSW_GAME_CATALOG : public testing::Test {
+protected:
+    void SetUp() override {
+        m_path = testing::TempDir() + "tsw_game_catalog_" + testing::UnitTest::GetInstance()->current_test_info()->name();
+        std::remove(m_path.c_str());
+    }
+    void TearDown() override { std::remove(m_path.c_str()); }
+
+    std::string m_path;
+};
+
+TEST_F(TSW_GAME_CATALOG, PERSISTS_BETWEEN_SESSIONS) {
+    {
+        GameIndex index(m_path);
+        index.add("over", { game("Overwatch", 20), game("Game Over", 5) }, true);
+        index.add("dark", { game("Dark Souls", 10) }, true);
+        EXPECT_TRUE(index.save());
+        EXPECT_EQ(0u, index.size());
+
+        // Still answered, now from the catalog.
+        std::vector<std::string> names;
+        EXPECT_TRUE(index.find("over", names));
+        EXPECT_EQ((std::vector<std::string> { "Overwatch", "Game Over" }), names);
+    }
+
+    GameIndex index(m_path);
+    std::vector<std::string> names;
+    EXPECT_TRUE(index.find("Over", names));
+    EXPECT_EQ((std::vector<std::string> { "Overwatch", "Game Over" }), names);
+    EXPECT_FALSE(index.find("portal", names));
+
+    // New games are merged with the catalog, keeping the better rank.
+    index.add("overw", { game("Overwatch 2", 50), game("Overwatch", 1) }, true);
+    names.clear();
+    EXPECT_TRUE(index.find("overw", names));
+    EXPECT_EQ((std::vector<std::string> { "Overwatch 2", "Overwatch" }), names);
+    EXPECT_TRUE(index.save());
+
+    GameIndex reopened(m_path);
+    names.clear();
+    EXPECT_TRUE(reopened.find("over", names));
+    EXPECT_EQ((std::vector<std::string> { "Overwatch 2", "Overwatch", "Game Over" }), names);
+    names.clear();
+    EXPECT_TRUE(reopened.find("dark", names));
+    EXPECT_EQ((std::vector<std::string> { "Dark Souls" }), names);
+}
+
+TEST_F(TSW_GAME_CATALOG, PERSISTS_FULL_PAGES) {
+    {
+        GameIndex index(m_path);
+        index.add("m", fullPage("Mario Kart", "Minecraft "), false);
+        index.add("ma", { game("Mario Kart") }, true);
+        // Searching again replaces the earlier search.
+        index.add("m", fullPage("Mario Kart", "Minecraft "), false);
+        EXPECT_TRUE(index.save());
+    }
+
+    GameIndex index(m_path);
+    std::vector<std::string> names;
+    EXPECT_TRUE(index.find("m", names));
+    names.clear();
+    EXPECT_FALSE(index.find("mi", names, 20));
+    EXPECT_TRUE(index.find("mari", names));
+    EXPECT_EQ((std::vector<std::string> { "Mario Kart" }), names);
+}
+
+TEST_F(TSW_GAME_CATALOG, IGNORES_UNUSABLE_FILES) {
+    EXPECT_TRUE(writeFileAtomically(m_path, "TSWG not a catalog"));
+    GameIndex index(m_path);
+    std::vector<std::string> names;
+    EXPECT_FALSE(index.find("over", names));
+
+    // Replaced by the next save.
+    index.add("over", { game("Overwatch") }, true);
+    EXPECT_TRUE(index.save());
+    GameIndex reopened(m_path);
+    EXPECT_TRUE(reopened.find("over", names));
+    EXPECT_EQ((std::vector<std::string> { "Overwatch" }), names);
+}
+
+TEST(TSW_GAME_INDEX, FINDS_SIMILAR_NAMES) {
+    GameIndex index;
+    index.add("over", { game("Overwatch"), game("Overcooked") }, true);
+    std::string canonical;
+    std::vector<std::string> names;
+    EXPECT_FALSE(index.resolve("Overwatch", canonical));
+    EXPECT_FALSE(index.findSimilar("Overwach", names));
+
+    index.buildSimilarityIndex();
+    EXPECT_TRUE(index.resolve("OVERWATCH!", canonical));
+    EXPECT_EQ("Overwatch", canonical);
+    EXPECT_FALSE(index.resolve("Overwach", canonical));
+    EXPECT_TRUE(index.findSimilar("Overwach", names));
+    EXPECT_EQ((std::vector<std::string> { "Overwatch" }), names);
+
+    // Games added after the index is built are matched too.
+    index.add("dark", { game("Dark Souls") }, true);
+    names.clear();
+    EXPECT_TRUE(index.findSimilar("Drak Souls", names));
+    EXPECT_EQ((std::vector<std::string> { "Dark Souls" }), names);
+    EXPECT_FALSE(index.findSimilar("Minecraft", names));
+}
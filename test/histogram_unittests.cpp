@@ -0,0 +1,66 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/histogram.h>
+
+using namespace twitchsw;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+TEST(TSW_HISTOGRAM, BUCKETS) {
+    EXPECT_EQ(0u, Histogram::bucketForValue(0));
+    EXPECT_EQ(1u, Histogram::bucketForValue(1));
+    EXPECT_EQ(2u, Histogram::bucketForValue(2));
+    EXPECT_EQ(2u, Histogram::bucketForValue(3));
+    EXPECT_EQ(3u, Histogram::bucketForValue(4));
+    EXPECT_EQ(11u, Histogram::bucketForValue(1024));
+    EXPECT_EQ(Histogram::kBuckets - 1, Histogram::bucketForValue(~uint64_t(0)));
+}
+
+TEST(TSW_HISTOGRAM, EMPTY) {
+    Histogram histogram;
+    EXPECT_EQ(0u, histogram.count());
+    EXPECT_EQ(microseconds(0), histogram.percentile(0.5));
+    EXPECT_EQ(microseconds(0), histogram.mean());
+    EXPECT_EQ(microseconds(0), histogram.max());
+}
+
+TEST(TSW_HISTOGRAM, PERCENTILES) {
+    Histogram histogram;
+    for (int i = 0; i < 99; ++i)
+        histogram.record(microseconds(100));
+    histogram.record(milliseconds(50));
+    EXPECT_EQ(100u, histogram.count());
+    EXPECT_EQ(microseconds(50000), histogram.max());
+
+    // 100us lands in [64, 128).
+    EXPECT_EQ(microseconds(127), histogram.percentile(0.5));
+    EXPECT_EQ(microseconds(127), histogram.percentile(0.99));
+    EXPECT_EQ(microseconds(50000), histogram.percentile(1.0));
+    EXPECT_EQ(microseconds((99 * 100 + 50000) / 100), histogram.mean());
+}
+
+TEST(TSW_HISTOGRAM, NEGATIVE_IS_ZERO) {
+    Histogram histogram;
+    histogram.record(microseconds(-5));
+    EXPECT_EQ(1u, histogram.bucketCount(0));
+    EXPECT_EQ(microseconds(0), histogram.max());
+}
+
+TEST(TSW_HISTOGRAM, MERGE) {
+    Histogram a;
+    Histogram b;
+    a.record(microseconds(10));
+    b.record(microseconds(1000));
+    b.record(microseconds(1000));
+    a.merge(b);
+    EXPECT_EQ(3u, a.count());
+    EXPECT_EQ(microseconds(1000), a.max());
+    EXPECT_EQ(2u, a.bucketCount(Histogram::bucketForValue(1000)));
+
+    a.reset();
+    EXPECT_EQ(0u, a.count());
+}
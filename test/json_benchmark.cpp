@@ -0,0 +1,147 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+// Times the JSON work each request does, and counts its heap allocations,
+// against the rapidjson code it replaced:
+// - encoding an update body with JsonTemplate::render(), against a Writer and
+//   StringBuffer;
+// - decoding a game search with JsonExtractor::parse(), as searchGames() does,
+//   against a SAX parse of the same response which handles nothing, which is as
+//   fast as reading it with rapidjson gets.
+//
+// Allocations are counted by wrapping malloc, which needs glibc; elsewhere the
+// column reads "-".
+//
+// Usage: json_benchmark [iterations]
+
+#include <twitchsw/jsonextractor.h>
+#include <twitchsw/jsontemplate.h>
+
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#if defined(__GLIBC__)
+#define COUNTS_ALLOCATIONS 1
+
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+
+// Not atomic: only the main thread allocates while counting.
+static bool s_counting = false;
+static unsigned long s_allocations = 0;
+
+extern "C" void* malloc(size_t size) {
+    s_allocations += s_counting;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    s_allocations += s_counting;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+    s_allocations += s_counting;
+    return __libc_realloc(pointer, size);
+}
+#endif
+
+using namespace twitchsw;
+typedef std::chrono::steady_clock Clock;
+
+static constexpr JsonTemplate<2> kKrakenChannelBody("{\"channel\":{", { "game", "status" }, "}}");
+
+static const std::string kGame = "The Legend of Zelda: Breath of the Wild";
+static const std::string kTitle = "100% run, no major glitches \xe2\x80\x94 day 3 | !schedule !discord \"chill vibes\"";
+
+// A /search/games response with 25 suggestions.
+static std::string searchResponse() {
+    std::string json = "{\"games\":[";
+    for (int i = 0; i < 25; ++i) {
+        if (i)
+            json += ",";
+        json += "{\"name\":\"Game \\\"" + std::to_string(i) + "\\\" Remastered\",\"popularity\":" + std::to_string(1000 - i) +
+            ",\"_id\":" + std::to_string(100000 + i) + ",\"box\":{\"large\":\"https://example.com/" + std::to_string(i) + ".jpg\"}}";
+    }
+    return json + "]}";
+}
+
+template <typename Function>
+static void run(const char* name, unsigned iterations, Function function) {
+    function();
+    auto start = Clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        function();
+    auto elapsed = Clock::now() - start;
+    double nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+
+#if COUNTS_ALLOCATIONS
+    // One more run, counted on its own, as every run allocates the same.
+    s_allocations = 0;
+    s_counting = true;
+    function();
+    s_counting = false;
+    std::printf("%-18s %12.1f %12lu\n", name, nanoseconds, s_allocations);
+#else
+    std::printf("%-18s %12.1f %12s\n", name, nanoseconds, "-");
+#endif
+}
+
+int main(int argc, char** argv) {
+    unsigned iterations = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 200000;
+    std::string response = searchResponse();
+    size_t checksum = 0;
+
+    std::printf("%u iterations\n\n", iterations);
+    std::printf("%-18s %12s %12s\n", "", "ns/op", "allocs/op");
+
+    run("encode writer", iterations, [&] {
+        using namespace rapidjson;
+        StringBuffer buffer;
+        Writer<StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("channel", 7);
+        writer.StartObject();
+        writer.Key("game", 4);
+        writer.String(kGame.c_str(), static_cast<SizeType>(kGame.length()));
+        writer.Key("status", 6);
+        writer.String(kTitle.c_str(), static_cast<SizeType>(kTitle.length()));
+        writer.EndObject();
+        writer.EndObject();
+        std::string body(buffer.GetString(), buffer.GetSize());
+        checksum += body.length();
+    });
+    run("encode template", iterations, [&] {
+        std::string body = kKrakenChannelBody.render(kGame, kTitle);
+        checksum += body.length();
+    });
+
+    run("decode sax", iterations, [&] {
+        // Parsed in a copy, as JsonExtractor does.
+        std::string copy = response;
+        rapidjson::Reader reader;
+        rapidjson::BaseReaderHandler<> handler;
+        rapidjson::InsituStringStream stream(&copy[0]);
+        checksum += reader.Parse<rapidjson::kParseInsituFlag>(stream, handler).IsError();
+    });
+    run("decode extractor", iterations, [&] {
+        JsonExtractor extractor;
+        extractor.forEach("games", { "name", "popularity" }, [&](const std::vector<String>& values) {
+            checksum += values[0].length();
+        });
+        checksum += extractor.parse(response);
+    });
+
+    // Keeps the work from being optimized away.
+    std::printf("\nchecksum %zu\n", checksum);
+    return 0;
+}
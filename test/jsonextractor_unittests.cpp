@@ -0,0 +1,87 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/jsonextractor.h>
+
+#include <string>
+#include <vector>
+
+using namespace twitchsw;
+
+TEST(TSW_JSON_EXTRACTOR, EXTRACTS_TOP_LEVEL_FIELDS) {
+    String name, id, missing;
+    JsonExtractor extractor;
+    extractor.field("display_name", name).field("_id", id).field("logo", missing);
+    EXPECT_TRUE(extractor.parse("{\"_links\": {\"display_name\": \"nested\"}, \"display_name\": \"caitp\","
+                                " \"logo\": null, \"_id\": 12345678901}"));
+    EXPECT_TRUE(name.equals("caitp"));
+    EXPECT_TRUE(id.equals("12345678901"));
+    EXPECT_TRUE(missing.isNull());
+}
+
+TEST(TSW_JSON_EXTRACTOR, STOPS_ONCE_EVERYTHING_IS_FOUND) {
+    String error, message;
+    JsonExtractor extractor;
+    extractor.field("error", error).field("message", message);
+    // Anything after the last requested member is never read.
+    EXPECT_TRUE(extractor.parse("{\"error\": \"Unauthorized\", \"status\": 401, \"message\": \"\", !!!"));
+    EXPECT_TRUE(error.equals("Unauthorized"));
+    EXPECT_FALSE(message.isNull());
+    EXPECT_TRUE(message.isEmpty());
+}
+
+TEST(TSW_JSON_EXTRACTOR, VISITS_ARRAY_ROWS) {
+    std::vector<std::string> names;
+    std::vector<std::string> ids;
+    JsonExtractor extractor;
+    extractor.forEach("data", { "name", "id" }, [&](const std::vector<String>& values) {
+        names.push_back(values[0].toStdString());
+        ids.push_back(values[1].toStdString());
+    });
+    EXPECT_TRUE(extractor.parse("{\"data\": [{\"id\": \"488552\", \"name\": \"Overwatch\"},"
+                                " {\"box_art_url\": {\"name\": \"x\"}, \"name\": \"Overcooked\"}, 7],"
+                                " \"pagination\": {}}"));
+    EXPECT_EQ((std::vector<std::string> { "Overwatch", "Overcooked" }), names);
+    EXPECT_EQ((std::vector<std::string> { "488552", "" }), ids);
+}
+
+TEST(TSW_JSON_EXTRACTOR, LIMITS_ARRAY_ROWS) {
+    String login;
+    JsonExtractor extractor;
+    extractor.forEach("data", { "login" }, [&](const std::vector<String>& values) {
+        login = values[0];
+    }, 1);
+    EXPECT_TRUE(extractor.parse("{\"data\": [{\"login\": \"caitp\"}, {\"login\": \"someone\"}"));
+    EXPECT_TRUE(login.equals("caitp"));
+}
+
+TEST(TSW_JSON_EXTRACTOR, REJECTS_OTHER_DOCUMENTS) {
+    String value;
+    JsonExtractor extractor;
+    extractor.field("value", value);
+    EXPECT_FALSE(extractor.parse("[{\"value\": 1}]"));
+    EXPECT_FALSE(extractor.parse("\"value\""));
+    EXPECT_FALSE(extractor.parse("{\"other\": 1,"));
+    EXPECT_FALSE(extractor.parse("Internal Server Error"));
+    EXPECT_TRUE(extractor.parse("{\"other\": 1}"));
+    EXPECT_TRUE(value.isNull());
+}
+
+TEST(TSW_JSON_EXTRACTOR, SHARES_THE_PARSED_BUFFER) {
+    String name, id;
+    {
+        std::string response = "{\"name\": \"Tom Clancy's \\\"The Division\\\"\", \"id\": \"1234\"}";
+        JsonExtractor extractor;
+        extractor.field("name", name).field("id", id);
+        EXPECT_TRUE(extractor.parse(response));
+        response.assign(response.length(), 'x');
+    }
+    // Unescaped in place, and still alive after both the response and the
+    // extractor are gone.
+    EXPECT_TRUE(name.equals("Tom Clancy's \"The Division\""));
+    EXPECT_TRUE(id.equals("1234"));
+    EXPECT_EQ(1u, name.refCount());
+}
@@ -0,0 +1,63 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/jsontemplate.h>
+
+#include <string>
+
+using namespace twitchsw;
+
+static constexpr JsonTemplate<2> kChannelBody("{\"channel\":{", { "game", "status" }, "}}");
+
+static std::string escape(const std::string& string) {
+    std::string result(jsonEscapedLength(string.data(), string.length()), '\0');
+    char* end = writeJsonEscaped(&result[0], string.data(), string.length());
+    EXPECT_EQ(result.length(), static_cast<size_t>(end - result.data()));
+    return result;
+}
+
+TEST(TSW_JSON_TEMPLATE, RENDERS_MEMBERS_IN_ORDER) {
+    EXPECT_EQ("{\"channel\":{\"game\":\"Overwatch\",\"status\":\"Ranked grind\"}}",
+              kChannelBody.render(std::string("Overwatch"), std::string("Ranked grind")));
+}
+
+TEST(TSW_JSON_TEMPLATE, LEAVES_OUT_EMPTY_MEMBERS) {
+    std::string empty;
+    EXPECT_EQ("{\"channel\":{\"status\":\"Just chatting\"}}", kChannelBody.render(empty, std::string("Just chatting")));
+    EXPECT_EQ("{\"channel\":{\"game\":\"Celeste\"}}", kChannelBody.render(std::string("Celeste"), empty));
+    EXPECT_EQ("{\"channel\":{}}", kChannelBody.render(empty, empty));
+
+    static constexpr JsonTemplate<1> kFlatBody("{", { "title" }, "}");
+    EXPECT_EQ("{\"title\":\"x\"}", kFlatBody.render(std::string("x")));
+}
+
+TEST(TSW_JSON_TEMPLATE, ESCAPES_LIKE_RAPIDJSON) {
+    EXPECT_EQ("plain title", escape("plain title"));
+    EXPECT_EQ("\\\"quoted\\\" \\\\ path/to", escape("\"quoted\" \\ path/to"));
+    EXPECT_EQ("line\\nbreak\\ttab\\r\\b\\f", escape("line\nbreak\ttab\r\b\f"));
+    EXPECT_EQ("\\u0000\\u001F\\u000B", escape(std::string("\0\x1f\x0b", 3)));
+    // UTF-8 and DEL pass through.
+    EXPECT_EQ("caf\xc3\xa9 \xe2\x80\x94 \x7f", escape("caf\xc3\xa9 \xe2\x80\x94 \x7f"));
+}
+
+TEST(TSW_JSON_TEMPLATE, ESCAPES_ACROSS_VECTOR_BOUNDARIES) {
+    // Every special byte at every position of strings spanning a few vectors,
+    // checked against the escaping of the byte on its own.
+    const char specials[] = { '"', '\\', '\n', '\x01', '\x1f' };
+    for (size_t length = 1; length <= 70; ++length) {
+        for (size_t position = 0; position < length; ++position) {
+            for (char special : specials) {
+                std::string string(length, 'a');
+                string[length - 1] = '\xc3';
+                string[position] = special;
+                std::string expected = escape(string.substr(0, position)) + escape(std::string(1, special)) +
+                    escape(string.substr(position + 1));
+                ASSERT_EQ(expected, escape(string)) << "length " << length << ", position " << position;
+            }
+        }
+    }
+    EXPECT_EQ(std::string(100, 'x'), escape(std::string(100, 'x')));
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/lrucache.h>
+
+#include <string>
+#include <vector>
+
+using namespace twitchsw;
+
+TEST(TSW_LRU_CACHE, GET_AND_PUT) {
+    LruCache<std::string, std::string> cache(4);
+    std::string value;
+    EXPECT_FALSE(cache.get("Overwatch", value));
+
+    cache.put("Overwatch", "488552");
+    EXPECT_TRUE(cache.get("Overwatch", value));
+    EXPECT_EQ("488552", value);
+
+    cache.put("Overwatch", "1");
+    EXPECT_EQ(1u, cache.size());
+    EXPECT_TRUE(cache.get("Overwatch", value));
+    EXPECT_EQ("1", value);
+}
+
+TEST(TSW_LRU_CACHE, EVICTS_LEAST_RECENTLY_USED) {
+    LruCache<int, int> cache(3);
+    cache.put(1, 10);
+    cache.put(2, 20);
+    cache.put(3, 30);
+
+    // Touching 1 makes 2 the least recently used.
+    int value;
+    EXPECT_TRUE(cache.get(1, value));
+    cache.put(4, 40);
+
+    EXPECT_EQ(3u, cache.size());
+    EXPECT_TRUE(cache.contains(1));
+    EXPECT_FALSE(cache.contains(2));
+    EXPECT_TRUE(cache.contains(3));
+    EXPECT_TRUE(cache.contains(4));
+
+    // Replacing a value also counts as a use.
+    cache.put(3, 31);
+    cache.put(5, 50);
+    EXPECT_FALSE(cache.contains(1));
+    EXPECT_TRUE(cache.contains(3));
+}
+
+TEST(TSW_LRU_CACHE, ERASE_AND_CLEAR) {
+    LruCache<int, int> cache(2);
+    cache.put(1, 10);
+    cache.put(2, 20);
+    EXPECT_TRUE(cache.erase(1));
+    EXPECT_FALSE(cache.erase(1));
+    cache.put(3, 30);
+    EXPECT_TRUE(cache.contains(2));
+    EXPECT_TRUE(cache.contains(3));
+
+    cache.clear();
+    EXPECT_TRUE(cache.isEmpty());
+    cache.put(4, 40);
+    EXPECT_EQ(1u, cache.size());
+}
+
+TEST(TSW_LRU_CACHE, FOR_EACH_PRESERVES_RECENCY) {
+    LruCache<int, int> cache(3);
+    cache.put(1, 10);
+    cache.put(2, 20);
+    cache.put(3, 30);
+    int value;
+    cache.get(1, value);
+
+    std::vector<int> order;
+    LruCache<int, int> copy(3);
+    cache.forEach([&](int key, int value) {
+        order.push_back(key);
+        copy.put(key, value);
+    });
+    EXPECT_EQ((std::vector<int> { 2, 3, 1 }), order);
+
+    copy.put(4, 40);
+    EXPECT_FALSE(copy.contains(2));
+    EXPECT_TRUE(copy.contains(1));
+}
@@ -0,0 +1,165 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+// Measures how much a busy background thread perturbs a simulated OBS encode
+// loop, for each ThreadScheduling policy.
+//
+// One "encoder" thread per logical CPU renders frames at 60fps, spending a fixed
+// share of each frame interval on CPU work. Alongside them, the same number of
+// "worker" threads spin on string churn and hashing (standing in for JSON
+// parsing and TLS), with the scheduling under test applied. A well-behaved
+// policy leaves frame times close to the baseline run with no workers at all.
+//
+// Usage: scheduling_benchmark [seconds per run] [encoder load, 0.0 - 1.0]
+
+#include <twitchsw/threadscheduling.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace twitchsw;
+typedef std::chrono::steady_clock Clock;
+
+static const Clock::duration kFrameInterval = std::chrono::microseconds(16667);
+
+static volatile uint64_t g_sink;
+
+static uint64_t spin(uint64_t iterations) {
+    uint64_t hash = 14695981039346656037ull;
+    for (uint64_t i = 0; i < iterations; ++i)
+        hash = (hash ^ i) * 1099511628211ull;
+    return hash;
+}
+
+// Iterations of spin() per millisecond on an otherwise idle core.
+static uint64_t calibrate() {
+    uint64_t iterations = 1 << 16;
+    while (true) {
+        auto start = Clock::now();
+        g_sink = spin(iterations);
+        auto elapsed = Clock::now() - start;
+        if (elapsed >= std::chrono::milliseconds(50))
+            return iterations * 1000000 / std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        iterations *= 2;
+    }
+}
+
+struct FrameStats {
+    std::vector<Clock::duration> frameTimes;
+    unsigned missed = 0;
+};
+
+static void encoderLoop(Clock::time_point end, uint64_t workPerFrame, FrameStats& stats) {
+    Clock::time_point next = Clock::now();
+    while (next < end) {
+        auto start = Clock::now();
+        g_sink = spin(workPerFrame);
+        auto done = Clock::now();
+        stats.frameTimes.push_back(done - start);
+
+        next += kFrameInterval;
+        if (done > next) {
+            // Dropped frame: skip ahead rather than trying to catch up.
+            ++stats.missed;
+            while (next < done)
+                next += kFrameInterval;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+static void workerLoop(const std::atomic<bool>& stop, const ThreadScheduling* scheduling, uint64_t& completed) {
+    setCurrentThreadName("TSW.BenchWorker");
+    if (scheduling && !applyCurrentThreadScheduling(*scheduling))
+        std::fprintf(stderr, "warning: could not apply '%s' scheduling\n", threadSchedulingPolicyName(scheduling->policy));
+
+    std::string buffer;
+    while (!stop.load(std::memory_order_relaxed)) {
+        buffer.clear();
+        for (int i = 0; i < 256; ++i)
+            buffer += "{\"game\":\"Some Game\",\"status\":\"Some Title\"}";
+        uint64_t hash = 0;
+        for (char c : buffer)
+            hash = hash * 31 + static_cast<unsigned char>(c);
+        g_sink = hash;
+        ++completed;
+    }
+}
+
+static void run(const char* name, const ThreadScheduling* scheduling, unsigned threads, double seconds, uint64_t workPerFrame) {
+    auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    std::atomic<bool> stop(false);
+
+    std::vector<uint64_t> completed(scheduling ? threads : 0);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < completed.size(); ++i)
+        workers.emplace_back(workerLoop, std::cref(stop), scheduling, std::ref(completed[i]));
+
+    std::vector<FrameStats> stats(threads);
+    std::vector<std::thread> encoders;
+    for (unsigned i = 0; i < threads; ++i)
+        encoders.emplace_back(encoderLoop, end, workPerFrame, std::ref(stats[i]));
+    for (auto& encoder : encoders)
+        encoder.join();
+
+    stop = true;
+    for (auto& worker : workers)
+        worker.join();
+
+    std::vector<Clock::duration> frameTimes;
+    unsigned missed = 0;
+    for (auto& encoder : stats) {
+        frameTimes.insert(frameTimes.end(), encoder.frameTimes.begin(), encoder.frameTimes.end());
+        missed += encoder.missed;
+    }
+    std::sort(frameTimes.begin(), frameTimes.end());
+    auto percentile = [&frameTimes](double p) {
+        if (frameTimes.empty())
+            return 0.0;
+        size_t index = std::min(frameTimes.size() - 1, static_cast<size_t>(p * frameTimes.size()));
+        return std::chrono::duration<double, std::milli>(frameTimes[index]).count();
+    };
+    uint64_t work = 0;
+    for (uint64_t count : completed)
+        work += count;
+
+    std::printf("%-10s %8zu %8u %9.3f %9.3f %9.3f %12llu\n", name, frameTimes.size(), missed,
+        percentile(0.5), percentile(0.99), percentile(1.0), static_cast<unsigned long long>(work));
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 5.0;
+    double load = argc > 2 ? std::atof(argv[2]) : 0.6;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    uint64_t perMillisecond = calibrate();
+    double frameMilliseconds = std::chrono::duration<double, std::milli>(kFrameInterval).count();
+    uint64_t workPerFrame = static_cast<uint64_t>(perMillisecond * frameMilliseconds * load);
+
+    std::printf("%u encoder threads at 60fps, %.0f%% load, %.1fs per run\n\n", threads, load * 100, seconds);
+    std::printf("%-10s %8s %8s %9s %9s %9s %12s\n", "workers", "frames", "missed", "p50 (ms)", "p99 (ms)", "max (ms)", "worker iters");
+
+    run("none", nullptr, threads, seconds, workPerFrame);
+
+    const ThreadScheduling::Policy policies[] = {
+        ThreadScheduling::Policy::Default,
+        ThreadScheduling::Policy::Batch,
+        ThreadScheduling::Policy::Idle,
+    };
+    for (auto policy : policies) {
+        ThreadScheduling scheduling;
+        scheduling.policy = policy;
+        if (policy != ThreadScheduling::Policy::Default)
+            scheduling.niceLevel = 10;
+        run(threadSchedulingPolicyName(policy), &scheduling, threads, seconds, workPerFrame);
+    }
+    return 0;
+}
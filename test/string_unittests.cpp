@@ -0,0 +1,161 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/atomstring.h>
+#include <twitchsw/string.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace twitchsw;
+
+TEST(TSW_STRING, COUNTS_REFERENCES) {
+    String title("Ranked grind");
+    EXPECT_EQ(1u, title.refCount());
+    {
+        String copy = title;
+        EXPECT_EQ(2u, title.refCount());
+        String moved = std::move(copy);
+        EXPECT_EQ(2u, title.refCount());
+    }
+    EXPECT_EQ(1u, title.refCount());
+}
+
+TEST(TSW_STRING, LEAVES_STATIC_STRINGS_UNCOUNTED) {
+    String empty(StringImpl::empty());
+    String copy = empty;
+    EXPECT_TRUE(empty.impl()->isStatic());
+    EXPECT_EQ(0u, copy.refCount());
+    EXPECT_TRUE(String("").isEmpty());
+}
+
+// Build with TSW_ENABLE_TSAN to check this under ThreadSanitizer.
+TEST(TSW_STRING, STRESS_SHARES_STRINGS_ACROSS_THREADS) {
+    const unsigned kThreads = 4;
+    const unsigned kRounds = 20;
+
+    std::atomic<unsigned> mismatches(0);
+    for (unsigned round = 0; round < kRounds; ++round) {
+        // As JsonExtractor hands them out: substrings keeping a shared buffer
+        // alive, whichever thread lets go of them last.
+        char* data;
+        String buffer(StringImpl::createUninitialized(data, 17));
+        std::memcpy(data, "Overwatch Celeste", 17);
+        std::vector<String> strings;
+        for (unsigned i = 0; i < 100; ++i) {
+            strings.push_back(i % 2 ? String(StringImpl::createWithoutCopying(data, 9, *buffer.impl()))
+                                    : String(StringImpl::createWithoutCopying(data + 10, 7, *buffer.impl())));
+        }
+        buffer = String();
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < kThreads; ++t) {
+            threads.emplace_back([strings, &mismatches]() mutable {
+                for (unsigned i = 0; i < strings.size(); ++i) {
+                    String copy = strings[i];
+                    if (!copy.equals(i % 2 ? "Overwatch" : "Celeste"))
+                        ++mismatches;
+                    strings[i] = String();
+                }
+            });
+        }
+        strings.clear();
+        for (auto& thread : threads)
+            thread.join();
+    }
+    EXPECT_EQ(0u, mismatches.load());
+}
+
+TEST(TSW_STRING, INTERNS_ATOMS) {
+    size_t atoms = AtomString::tableSize();
+    {
+        String substring(StringImpl::createWithoutCopying("Overwatch", 4));
+        AtomString a("Over");
+        AtomString b(std::string("Over"));
+        AtomString c(substring);
+        AtomString d("Overwatch");
+        EXPECT_TRUE(a == b);
+        EXPECT_TRUE(a == c);
+        EXPECT_TRUE(a != d);
+        EXPECT_TRUE(a.impl()->isAtom());
+        EXPECT_EQ(3u, a.string().refCount());
+        EXPECT_EQ(atoms + 2, AtomString::tableSize());
+
+        EXPECT_TRUE(AtomString("") == AtomString(std::string()));
+        EXPECT_TRUE(AtomString().isNull());
+        EXPECT_TRUE(AtomString() != AtomString(""));
+    }
+    // Atoms leave the table with their last reference.
+    EXPECT_EQ(atoms, AtomString::tableSize());
+}
+
+TEST(TSW_STRING, STRESS_INTERNS_ACROSS_THREADS) {
+    const unsigned kThreads = 4;
+    const char* const kNames[] = { "Overwatch", "Celeste", "Just Chatting", "Hades" };
+
+    // Each thread keeps interning and dropping the same names, racing other
+    // threads to remove or revive them.
+    std::atomic<unsigned> mismatches(0);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&kNames, &mismatches] {
+            for (unsigned i = 0; i < 5000; ++i) {
+                AtomString a(kNames[i % 4]);
+                AtomString b(std::string(kNames[i % 4]));
+                if (a != b || !a.string().equals(kNames[i % 4]))
+                    ++mismatches;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(0u, mismatches.load());
+}
+
+TEST(TSW_STRING, CACHES_HASHES) {
+    String title("Speedrunning Celeste any% \xe2\x80\x94 PB attempts all night, 27:xx goal | !schedule");
+    String copy(title.toStdString());
+    EXPECT_EQ(0u, title.impl()->existingHash());
+    unsigned hash = title.hash();
+    EXPECT_NE(0u, hash);
+    EXPECT_EQ(hash, title.impl()->existingHash());
+    EXPECT_EQ(hash, copy.hash());
+    EXPECT_EQ(hash, StringImpl::computeHash(title.characters(), title.length()));
+    EXPECT_EQ(String().hash(), String("").hash());
+
+    EXPECT_TRUE(title == copy);
+    EXPECT_TRUE(String() == String(""));
+    EXPECT_TRUE(title != String("Speedrunning Celeste"));
+    EXPECT_EQ(AtomString(title).hash(), hash);
+}
+
+TEST(TSW_STRING, HASHES_INTO_UNORDERED_CONTAINERS) {
+    // Every length up to a few of the long-string blocks, and strings which
+    // differ in a single byte.
+    std::unordered_set<String> strings;
+    std::unordered_set<unsigned> hashes;
+    std::string base(160, 'a');
+    for (unsigned length = 0; length <= base.length(); ++length) {
+        for (unsigned position = 0; position < length; position += 7) {
+            std::string string = base.substr(0, length);
+            string[position] = 'b';
+            EXPECT_TRUE(strings.insert(String(string)).second);
+            hashes.insert(String(string).hash());
+        }
+    }
+    EXPECT_EQ(strings.size(), hashes.size());
+    EXPECT_EQ(1u, strings.count(String(std::string(3, 'a').replace(0, 1, "b"))));
+    EXPECT_EQ(0u, strings.count(String("missing")));
+
+    std::unordered_map<AtomString, int> scenes;
+    scenes[AtomString("Starting Soon")] = 1;
+    scenes[AtomString("Gameplay")] = 2;
+    EXPECT_EQ(2, scenes[AtomString(std::string("Gameplay"))]);
+}
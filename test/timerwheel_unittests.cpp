@@ -0,0 +1,116 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/timerwheel.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace twitchsw;
+using std::chrono::milliseconds;
+
+TEST(TSW_TIMERWHEEL, FIRE_ONCE) {
+    TimerWheel::TimePoint epoch;
+    TimerWheel wheel(milliseconds(10), epoch);
+    int fired = 0;
+    wheel.schedule(epoch + milliseconds(25), [&] { ++fired; });
+    EXPECT_EQ(1u, wheel.size());
+
+    EXPECT_EQ(0u, wheel.advance(epoch + milliseconds(20)));
+    EXPECT_EQ(0, fired);
+    EXPECT_EQ(1u, wheel.advance(epoch + milliseconds(30)));
+    EXPECT_EQ(1, fired);
+    EXPECT_TRUE(wheel.isEmpty());
+    EXPECT_EQ(0u, wheel.advance(epoch + milliseconds(1000)));
+    EXPECT_EQ(1, fired);
+}
+
+TEST(TSW_TIMERWHEEL, CANCEL) {
+    TimerWheel::TimePoint epoch;
+    TimerWheel wheel(milliseconds(10), epoch);
+    int fired = 0;
+    auto timer = wheel.schedule(epoch + milliseconds(50), [&] { ++fired; });
+    EXPECT_TRUE(timer->isScheduled());
+    EXPECT_TRUE(wheel.cancel(timer));
+    EXPECT_FALSE(timer->isScheduled());
+    EXPECT_FALSE(wheel.cancel(timer));
+    EXPECT_TRUE(wheel.isEmpty());
+    wheel.advance(epoch + milliseconds(100));
+    EXPECT_EQ(0, fired);
+}
+
+TEST(TSW_TIMERWHEEL, ORDERING_ACROSS_LEVELS) {
+    TimerWheel::TimePoint epoch;
+    TimerWheel wheel(milliseconds(1), epoch);
+    std::vector<int> order;
+    // Spread deadlines across every level of the wheel.
+    const int deadlines[] = { 20000000, 5000000, 3, 70, 63, 64, 4095, 4096, 4097, 262143, 262144, 300000 };
+    for (int deadline : deadlines)
+        wheel.schedule(epoch + milliseconds(deadline), [&order, deadline] { order.push_back(deadline); });
+
+    // Advance in uneven steps, to exercise skipping ahead and cascading.
+    int now = 0;
+    while (!wheel.isEmpty()) {
+        TimerWheel::TimePoint deadline;
+        ASSERT_TRUE(wheel.nextDeadline(deadline));
+        EXPECT_GT(deadline, epoch + milliseconds(now));
+        now += 997;
+        size_t before = order.size();
+        wheel.advance(epoch + milliseconds(now));
+        for (size_t i = before; i < order.size(); ++i)
+            EXPECT_LE(order[i], now);
+    }
+
+    std::vector<int> expected(std::begin(deadlines), std::end(deadlines));
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(expected, order);
+}
+
+TEST(TSW_TIMERWHEEL, NEXT_DEADLINE_IS_EXACT_FOR_NEAR_TIMERS) {
+    TimerWheel::TimePoint epoch;
+    TimerWheel wheel(milliseconds(10), epoch);
+    TimerWheel::TimePoint deadline;
+    EXPECT_FALSE(wheel.nextDeadline(deadline));
+
+    wheel.schedule(epoch + milliseconds(300), [] { });
+    wheel.schedule(epoch + milliseconds(120), [] { });
+    ASSERT_TRUE(wheel.nextDeadline(deadline));
+    EXPECT_EQ(epoch + milliseconds(120), deadline);
+}
+
+TEST(TSW_TIMERWHEEL, REPEATING) {
+    TimerWheel::TimePoint epoch;
+    TimerWheel wheel(milliseconds(10), epoch);
+    int fired = 0;
+    RefPtr<TimerWheel::Timer> timer;
+    timer = wheel.schedule(epoch + milliseconds(100), [&] {
+        if (++fired == 3)
+            wheel.cancel(*timer);
+    }, milliseconds(100)).ptr();
+
+    wheel.advance(epoch + milliseconds(250));
+    EXPECT_EQ(2, fired);
+    EXPECT_TRUE(timer->isScheduled());
+    wheel.advance(epoch + milliseconds(1000));
+    EXPECT_EQ(3, fired);
+    EXPECT_FALSE(timer->isScheduled());
+    EXPECT_TRUE(wheel.isEmpty());
+}
+
+TEST(TSW_TIMERWHEEL, SCHEDULE_FROM_CALLBACK) {
+    TimerWheel::TimePoint epoch;
+    TimerWheel wheel(milliseconds(10), epoch);
+    std::vector<int> order;
+    wheel.schedule(epoch + milliseconds(10), [&] {
+        order.push_back(1);
+        // Already due, but must not run until the wheel advances again.
+        wheel.schedule(epoch, [&] { order.push_back(2); });
+    });
+    wheel.advance(epoch + milliseconds(10));
+    EXPECT_EQ(std::vector<int>({ 1 }), order);
+    wheel.advance(epoch + milliseconds(20));
+    EXPECT_EQ(std::vector<int>({ 1, 2 }), order);
+}
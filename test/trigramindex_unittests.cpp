@@ -0,0 +1,82 @@
+// Copyright (C) 2016 Caitlin Potter & Contributors. All rights reserved.
+// Use of this source is governed by the Apache License, Version 2.0 that
+// can be found in the LICENSE file, which must be distributed with this
+// software.
+
+#include <gtest/gtest.h>
+#include <twitchsw/trigramindex.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace twitchsw;
+
+TEST(TSW_TRIGRAM_INDEX, TRIGRAMS) {
+    std::vector<uint32_t> trigrams;
+    TrigramIndex::trigrams("abab", trigrams);
+    // " ab", "aba", "bab", "ab " ("bab" and "aba" once each).
+    EXPECT_EQ(4u, trigrams.size());
+    EXPECT_TRUE(std::is_sorted(trigrams.begin(), trigrams.end()));
+
+    TrigramIndex::trigrams("", trigrams);
+    EXPECT_TRUE(trigrams.empty());
+}
+
+TEST(TSW_TRIGRAM_INDEX, FINDS_MISSPELLINGS) {
+    TrigramIndex index;
+    EXPECT_EQ(0u, index.add("overwatch"));
+    EXPECT_EQ(1u, index.add("overcooked"));
+    EXPECT_EQ(2u, index.add("dark souls"));
+    EXPECT_EQ(3u, index.size());
+
+    auto matches = index.search("overwatc", 3);
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(0u, matches[0].id);
+
+    matches = index.search("darksouls", 3);
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(2u, matches[0].id);
+
+    // An exact match scores 1.
+    matches = index.search("overcooked", 1);
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(1u, matches[0].id);
+    EXPECT_DOUBLE_EQ(1.0, matches[0].score);
+
+    EXPECT_TRUE(index.search("minecraft", 3).empty());
+    EXPECT_TRUE(index.search("", 3).empty());
+}
+
+TEST(TSW_TRIGRAM_INDEX, RANKS_AND_LIMITS) {
+    TrigramIndex index;
+    index.add("overwatch");
+    index.add("overwatch 2");
+    index.add("overwatch league");
+
+    auto matches = index.search("overwatch", 10, 0.0);
+    ASSERT_EQ(3u, matches.size());
+    EXPECT_EQ(0u, matches[0].id);
+    EXPECT_EQ(1u, matches[1].id);
+    EXPECT_EQ(2u, matches[2].id);
+    EXPECT_GT(matches[0].score, matches[1].score);
+
+    EXPECT_EQ(1u, index.search("overwatch", 1, 0.0).size());
+
+    // Searching leaves no state behind.
+    matches = index.search("overwatch", 10, 0.0);
+    EXPECT_DOUBLE_EQ(1.0, matches[0].score);
+}
+
+TEST(TSW_TRIGRAM_INDEX, LARGE_CATALOG) {
+    TrigramIndex index;
+    std::string name;
+    for (size_t i = 0; i < 200000; ++i) {
+        name = "game " + std::to_string(i * 7919 % 1000003);
+        index.add(name);
+    }
+    size_t target = index.add("the legend of zelda breath of the wild");
+    auto matches = index.search("legend of zelda breth of the wild", 1);
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(target, matches[0].id);
+}